@@ -0,0 +1,685 @@
+#include "benchHost.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace BenchHost {
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // frame format
+
+    int FrameFormat::bytesPerComponent() const
+    {
+        if (bitDepth == kOfxBitDepthByte) return 1;
+        if (bitDepth == kOfxBitDepthShort || bitDepth == kOfxBitDepthHalf) return 2;
+        return 4;
+    }
+
+    int FrameFormat::componentCount() const
+    {
+        if (components == kOfxImageComponentAlpha) return 1;
+        if (components == kOfxImageComponentRGB) return 3;
+        return 4;
+    }
+
+    // IEEE 754 binary32 -> binary16, round to nearest even (test pattern only)
+    static unsigned short floatToHalf(float f)
+    {
+        unsigned int x;
+        memcpy(&x, &f, sizeof(x));
+        const unsigned int sign = (x >> 16) & 0x8000;
+        int exponent = (int)((x >> 23) & 0xff) - 127 + 15;
+        unsigned int mantissa = x & 0x7fffff;
+        if (exponent <= 0) {
+            if (exponent < -10) return (unsigned short)sign;
+            mantissa |= 0x800000;
+            const unsigned int shift = (unsigned int)(14 - exponent);
+            unsigned int half = mantissa >> shift;
+            if ((mantissa >> (shift - 1)) & 1) half++;
+            return (unsigned short)(sign | half);
+        }
+        if (exponent >= 31) return (unsigned short)(sign | 0x7c00);
+        unsigned int half = sign | ((unsigned int)exponent << 10) | (mantissa >> 13);
+        if ((mantissa & 0x1fff) > 0x1000 || ((mantissa & 0x1fff) == 0x1000 && (half & 1))) half++;
+        return (unsigned short)half;
+    }
+
+    // deterministic test pattern in [0,1]: gradients plus a fine checkerboard so
+    // that any resampling change shows up in the output
+    static float patternValue(int x, int y, int c)
+    {
+        const float checker = ((x / 16 + y / 16) & 1) ? 0.25f : 0.0f;
+        switch (c) {
+        case 0: return 0.7f * (float)(x % 512) / 511.0f + checker;
+        case 1: return 0.7f * (float)(y % 512) / 511.0f + checker;
+        case 2: return 0.5f + 0.45f * (float)std::sin(0.05 * x + 0.031 * y);
+        default: return 1.0f - checker;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // image
+
+    Image::Image(ClipInstance &clip, const FrameFormat &format, unsigned char *frame, const OfxRectI &bounds)
+        : OFX::Host::ImageEffect::Image(clip, 1.0, 1.0,
+                                        frame + (size_t)bounds.y1 * format.rowBytes() + (size_t)bounds.x1 * format.bytesPerPixel(),
+                                        bounds,
+                                        bounds,
+                                        format.rowBytes(),
+                                        kOfxImageFieldNone,
+                                        "")
+    {
+        // the region of definition is always the whole frame
+        setIntProperty(kOfxImagePropRegionOfDefinition, 0, 0);
+        setIntProperty(kOfxImagePropRegionOfDefinition, 0, 1);
+        setIntProperty(kOfxImagePropRegionOfDefinition, format.width, 2);
+        setIntProperty(kOfxImagePropRegionOfDefinition, format.height, 3);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // clip
+
+    ClipInstance::ClipInstance(EffectInstance *effect, OFX::Host::ImageEffect::ClipDescriptor *desc)
+        : OFX::Host::ImageEffect::ClipInstance(effect, *desc)
+        , _effect(effect)
+        , _name(desc->getName())
+    {
+        _fetchBounds.x1 = _fetchBounds.y1 = _fetchBounds.x2 = _fetchBounds.y2 = 0;
+    }
+
+    void ClipInstance::allocateFrame()
+    {
+        const FrameFormat &format = _effect->getFormat();
+        _frame.assign(format.frameBytes(), 0);
+        _fetchBounds.x1 = _fetchBounds.y1 = 0;
+        _fetchBounds.x2 = format.width;
+        _fetchBounds.y2 = format.height;
+
+        if (isOutput()) {
+            return;
+        }
+
+        const int nComps = format.componentCount();
+        const int firstComp = nComps == 1 ? 3 : 0;
+        for (int y = 0; y < format.height; ++y) {
+            unsigned char *row = &_frame[(size_t)y * format.rowBytes()];
+            for (int x = 0; x < format.width; ++x) {
+                for (int c = 0; c < nComps; ++c) {
+                    const float v = std::min(1.0f, std::max(0.0f, patternValue(x, y, firstComp + c)));
+                    const size_t i = (size_t)x * nComps + c;
+                    if (format.bitDepth == kOfxBitDepthByte) {
+                        row[i] = (unsigned char)(v * 255.0f + 0.5f);
+                    } else if (format.bitDepth == kOfxBitDepthShort) {
+                        ((unsigned short *)row)[i] = (unsigned short)(v * 65535.0f + 0.5f);
+                    } else if (format.bitDepth == kOfxBitDepthHalf) {
+                        ((unsigned short *)row)[i] = floatToHalf(v);
+                    } else {
+                        ((float *)row)[i] = v;
+                    }
+                }
+            }
+        }
+    }
+
+    const std::string &ClipInstance::getUnmappedBitDepth() const
+    {
+        return _effect->getFormat().bitDepth;
+    }
+
+    const std::string &ClipInstance::getUnmappedComponents() const
+    {
+        return _effect->getFormat().components;
+    }
+
+    const std::string &ClipInstance::getPremult() const
+    {
+        static const std::string v(kOfxImageUnPreMultiplied);
+        return v;
+    }
+
+    double ClipInstance::getAspectRatio() const
+    {
+        return 1.0;
+    }
+
+    double ClipInstance::getFrameRate() const
+    {
+        return 25.0;
+    }
+
+    void ClipInstance::getFrameRange(double &startFrame, double &endFrame) const
+    {
+        startFrame = 0;
+        endFrame = 100;
+    }
+
+    const std::string &ClipInstance::getFieldOrder() const
+    {
+        static const std::string v(kOfxImageFieldNone);
+        return v;
+    }
+
+    bool ClipInstance::getConnected() const
+    {
+        return true;
+    }
+
+    double ClipInstance::getUnmappedFrameRate() const
+    {
+        return 25.0;
+    }
+
+    void ClipInstance::getUnmappedFrameRange(double &unmappedStartFrame, double &unmappedEndFrame) const
+    {
+        unmappedStartFrame = 0;
+        unmappedEndFrame = 100;
+    }
+
+    bool ClipInstance::getContinuousSamples() const
+    {
+        return false;
+    }
+
+    OfxRectD ClipInstance::getRegionOfDefinition(OfxTime time) const
+    {
+        OfxRectD v;
+        v.x1 = v.y1 = 0;
+        v.x2 = _effect->getFormat().width;
+        v.y2 = _effect->getFormat().height;
+        return v;
+    }
+
+    OFX::Host::ImageEffect::Image *ClipInstance::getImage(OfxTime time, const OfxRectD *optionalBounds)
+    {
+        const FrameFormat &format = _effect->getFormat();
+        OfxRectI bounds = _fetchBounds;
+        if (optionalBounds) {
+            bounds.x1 = (int)std::floor(optionalBounds->x1);
+            bounds.y1 = (int)std::floor(optionalBounds->y1);
+            bounds.x2 = (int)std::ceil(optionalBounds->x2);
+            bounds.y2 = (int)std::ceil(optionalBounds->y2);
+        }
+        bounds.x1 = std::max(0, bounds.x1);
+        bounds.y1 = std::max(0, bounds.y1);
+        bounds.x2 = std::max(bounds.x1, std::min(format.width, bounds.x2));
+        bounds.y2 = std::max(bounds.y1, std::min(format.height, bounds.y2));
+
+        // the image only references the clip frame, and is deleted once the
+        // plugin releases it
+        return new Image(*this, format, &_frame[0], bounds);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // parameters, each just keeps its current value (no animation)
+
+    class IntegerParam : public OFX::Host::Param::IntegerInstance {
+        int _value;
+    public:
+        IntegerParam(OFX::Host::Param::Descriptor &descriptor)
+            : OFX::Host::Param::IntegerInstance(descriptor)
+            , _value(descriptor.getProperties().getIntProperty(kOfxParamPropDefault)) {}
+        OfxStatus get(int &v) { v = _value; return kOfxStatOK; }
+        OfxStatus get(OfxTime, int &v) { v = _value; return kOfxStatOK; }
+        OfxStatus set(int v) { _value = v; return kOfxStatOK; }
+        OfxStatus set(OfxTime, int v) { _value = v; return kOfxStatOK; }
+    };
+
+    class ChoiceParam : public OFX::Host::Param::ChoiceInstance {
+        int _value;
+    public:
+        ChoiceParam(OFX::Host::Param::Descriptor &descriptor)
+            : OFX::Host::Param::ChoiceInstance(descriptor)
+            , _value(descriptor.getProperties().getIntProperty(kOfxParamPropDefault)) {}
+        OfxStatus get(int &v) { v = _value; return kOfxStatOK; }
+        OfxStatus get(OfxTime, int &v) { v = _value; return kOfxStatOK; }
+        OfxStatus set(int v) { _value = v; return kOfxStatOK; }
+        OfxStatus set(OfxTime, int v) { _value = v; return kOfxStatOK; }
+    };
+
+    class BooleanParam : public OFX::Host::Param::BooleanInstance {
+        bool _value;
+    public:
+        BooleanParam(OFX::Host::Param::Descriptor &descriptor)
+            : OFX::Host::Param::BooleanInstance(descriptor)
+            , _value(descriptor.getProperties().getIntProperty(kOfxParamPropDefault) != 0) {}
+        OfxStatus get(bool &v) { v = _value; return kOfxStatOK; }
+        OfxStatus get(OfxTime, bool &v) { v = _value; return kOfxStatOK; }
+        OfxStatus set(bool v) { _value = v; return kOfxStatOK; }
+        OfxStatus set(OfxTime, bool v) { _value = v; return kOfxStatOK; }
+    };
+
+    class DoubleParam : public OFX::Host::Param::DoubleInstance {
+        double _value;
+    public:
+        DoubleParam(OFX::Host::Param::Descriptor &descriptor)
+            : OFX::Host::Param::DoubleInstance(descriptor)
+            , _value(descriptor.getProperties().getDoubleProperty(kOfxParamPropDefault)) {}
+        OfxStatus get(double &v) { v = _value; return kOfxStatOK; }
+        OfxStatus get(OfxTime, double &v) { v = _value; return kOfxStatOK; }
+        OfxStatus set(double v) { _value = v; return kOfxStatOK; }
+        OfxStatus set(OfxTime, double v) { _value = v; return kOfxStatOK; }
+        OfxStatus derive(OfxTime, double &v) { v = 0; return kOfxStatOK; }
+        OfxStatus integrate(OfxTime t1, OfxTime t2, double &v) { v = _value * (t2 - t1); return kOfxStatOK; }
+    };
+
+    class Double2DParam : public OFX::Host::Param::Double2DInstance {
+        double _x, _y;
+    public:
+        Double2DParam(OFX::Host::Param::Descriptor &descriptor)
+            : OFX::Host::Param::Double2DInstance(descriptor)
+            , _x(descriptor.getProperties().getDoubleProperty(kOfxParamPropDefault, 0))
+            , _y(descriptor.getProperties().getDoubleProperty(kOfxParamPropDefault, 1)) {}
+        OfxStatus get(double &x, double &y) { x = _x; y = _y; return kOfxStatOK; }
+        OfxStatus get(OfxTime, double &x, double &y) { x = _x; y = _y; return kOfxStatOK; }
+        OfxStatus set(double x, double y) { _x = x; _y = y; return kOfxStatOK; }
+        OfxStatus set(OfxTime, double x, double y) { _x = x; _y = y; return kOfxStatOK; }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // effect instance
+
+    EffectInstance::EffectInstance(OFX::Host::ImageEffect::ImageEffectPlugin *plugin,
+                                   OFX::Host::ImageEffect::Descriptor &desc,
+                                   const std::string &context)
+        : OFX::Host::ImageEffect::Instance(plugin, desc, context, false)
+    {
+        _format.width = 1920;
+        _format.height = 1080;
+        _format.bitDepth = kOfxBitDepthByte;
+        _format.components = kOfxImageComponentRGBA;
+    }
+
+    bool EffectInstance::setDouble(const std::string &name, double v)
+    {
+        DoubleParam *p = dynamic_cast<DoubleParam *>(getParam(name));
+        return p && p->set(v) == kOfxStatOK;
+    }
+
+    bool EffectInstance::setDouble2D(const std::string &name, double x, double y)
+    {
+        Double2DParam *p = dynamic_cast<Double2DParam *>(getParam(name));
+        return p && p->set(x, y) == kOfxStatOK;
+    }
+
+    bool EffectInstance::setInt(const std::string &name, int v)
+    {
+        IntegerParam *p = dynamic_cast<IntegerParam *>(getParam(name));
+        return p && p->set(v) == kOfxStatOK;
+    }
+
+    bool EffectInstance::setChoice(const std::string &name, int v)
+    {
+        ChoiceParam *p = dynamic_cast<ChoiceParam *>(getParam(name));
+        return p && p->set(v) == kOfxStatOK;
+    }
+
+    bool EffectInstance::setBoolean(const std::string &name, bool v)
+    {
+        BooleanParam *p = dynamic_cast<BooleanParam *>(getParam(name));
+        return p && p->set(v) == kOfxStatOK;
+    }
+
+    OFX::Host::ImageEffect::ClipInstance *EffectInstance::newClipInstance(OFX::Host::ImageEffect::Instance *plugin,
+                                                                          OFX::Host::ImageEffect::ClipDescriptor *descriptor,
+                                                                          int index)
+    {
+        return new ClipInstance(this, descriptor);
+    }
+
+    const std::string &EffectInstance::getDefaultOutputFielding() const
+    {
+        static const std::string v(kOfxImageFieldNone);
+        return v;
+    }
+
+    OfxStatus EffectInstance::vmessage(const char *type, const char *id, const char *format, va_list args)
+    {
+        fprintf(stderr, "%s %s ", type, id);
+        vfprintf(stderr, format, args);
+        fprintf(stderr, "\n");
+        return kOfxStatOK;
+    }
+
+    OfxStatus EffectInstance::setPersistentMessage(const char *type, const char *id, const char *format, va_list args)
+    {
+        return vmessage(type, id, format, args);
+    }
+
+    OfxStatus EffectInstance::clearPersistentMessage()
+    {
+        return kOfxStatOK;
+    }
+
+    void EffectInstance::getProjectSize(double &xSize, double &ySize) const
+    {
+        xSize = _format.width;
+        ySize = _format.height;
+    }
+
+    void EffectInstance::getProjectOffset(double &xOffset, double &yOffset) const
+    {
+        xOffset = yOffset = 0;
+    }
+
+    void EffectInstance::getProjectExtent(double &xSize, double &ySize) const
+    {
+        xSize = _format.width;
+        ySize = _format.height;
+    }
+
+    double EffectInstance::getProjectPixelAspectRatio() const
+    {
+        return 1.0;
+    }
+
+    double EffectInstance::getEffectDuration() const
+    {
+        return 100.0;
+    }
+
+    double EffectInstance::getFrameRate() const
+    {
+        return 25.0;
+    }
+
+    double EffectInstance::getFrameRecursive() const
+    {
+        return 0.0;
+    }
+
+    void EffectInstance::getRenderScaleRecursive(double &x, double &y) const
+    {
+        x = y = 1.0;
+    }
+
+    OFX::Host::Param::Instance *EffectInstance::newParam(const std::string &name, OFX::Host::Param::Descriptor &descriptor)
+    {
+        if (descriptor.getType() == kOfxParamTypeInteger)
+            return new IntegerParam(descriptor);
+        else if (descriptor.getType() == kOfxParamTypeDouble)
+            return new DoubleParam(descriptor);
+        else if (descriptor.getType() == kOfxParamTypeBoolean)
+            return new BooleanParam(descriptor);
+        else if (descriptor.getType() == kOfxParamTypeChoice)
+            return new ChoiceParam(descriptor);
+        else if (descriptor.getType() == kOfxParamTypeDouble2D)
+            return new Double2DParam(descriptor);
+        else if (descriptor.getType() == kOfxParamTypeGroup)
+            return new OFX::Host::Param::GroupInstance(descriptor, this);
+        else if (descriptor.getType() == kOfxParamTypePage)
+            return new OFX::Host::Param::PageInstance(descriptor, this);
+        else
+            return 0;
+    }
+
+    OfxStatus EffectInstance::editBegin(const std::string &name)
+    {
+        return kOfxStatErrMissingHostFeature;
+    }
+
+    OfxStatus EffectInstance::editEnd()
+    {
+        return kOfxStatErrMissingHostFeature;
+    }
+
+    void EffectInstance::progressStart(const std::string &message, const std::string &messageid)
+    {
+    }
+
+    void EffectInstance::progressEnd()
+    {
+    }
+
+    bool EffectInstance::progressUpdate(double t)
+    {
+        return true;
+    }
+
+    double EffectInstance::timeLineGetTime()
+    {
+        return 0;
+    }
+
+    void EffectInstance::timeLineGotoTime(double t)
+    {
+    }
+
+    void EffectInstance::timeLineGetBounds(double &t1, double &t2)
+    {
+        t1 = 0;
+        t2 = 100;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // host
+
+    Host::Host()
+        : _maxThreads(std::max(1u, std::thread::hardware_concurrency()))
+    {
+        _properties.setIntProperty(kOfxPropAPIVersion, 1, 0);
+        _properties.setIntProperty(kOfxPropAPIVersion, 4, 1);
+        _properties.setStringProperty(kOfxPropName, "FluidSwirlBench");
+        _properties.setStringProperty(kOfxPropLabel, "FluidSwirl Benchmark Host");
+        _properties.setIntProperty(kOfxPropVersion, 1, 0);
+        _properties.setIntProperty(kOfxPropVersion, 0, 1);
+        _properties.setStringProperty(kOfxPropVersionLabel, "1.0");
+        _properties.setIntProperty(kOfxImageEffectHostPropIsBackground, 1);
+        _properties.setIntProperty(kOfxImageEffectPropSupportsOverlays, 0);
+        _properties.setIntProperty(kOfxImageEffectPropSupportsMultiResolution, 1);
+        _properties.setIntProperty(kOfxImageEffectPropSupportsTiles, 1);
+        _properties.setIntProperty(kOfxImageEffectPropTemporalClipAccess, 0);
+        _properties.setStringProperty(kOfxImageEffectPropSupportedComponents, kOfxImageComponentRGBA, 0);
+        _properties.setStringProperty(kOfxImageEffectPropSupportedComponents, kOfxImageComponentRGB, 1);
+        _properties.setStringProperty(kOfxImageEffectPropSupportedComponents, kOfxImageComponentAlpha, 2);
+        _properties.setStringProperty(kOfxImageEffectPropSupportedContexts, kOfxImageEffectContextFilter, 0);
+        _properties.setIntProperty(kOfxImageEffectPropSupportsMultipleClipDepths, 0);
+        _properties.setIntProperty(kOfxImageEffectPropSupportsMultipleClipPARs, 0);
+        _properties.setIntProperty(kOfxImageEffectPropSetableFrameRate, 0);
+        _properties.setIntProperty(kOfxImageEffectPropSetableFielding, 0);
+        _properties.setIntProperty(kOfxParamHostPropSupportsCustomInteract, 0);
+        _properties.setIntProperty(kOfxParamHostPropSupportsStringAnimation, 0);
+        _properties.setIntProperty(kOfxParamHostPropSupportsChoiceAnimation, 0);
+        _properties.setIntProperty(kOfxParamHostPropSupportsBooleanAnimation, 0);
+        _properties.setIntProperty(kOfxParamHostPropSupportsCustomAnimation, 0);
+        _properties.setIntProperty(kOfxParamHostPropMaxParameters, -1);
+        _properties.setIntProperty(kOfxParamHostPropMaxPages, 0);
+        _properties.setIntProperty(kOfxParamHostPropPageRowColumnCount, 0, 0);
+        _properties.setIntProperty(kOfxParamHostPropPageRowColumnCount, 0, 1);
+    }
+
+    OFX::Host::ImageEffect::Instance *Host::newInstance(void *clientData,
+                                                        OFX::Host::ImageEffect::ImageEffectPlugin *plugin,
+                                                        OFX::Host::ImageEffect::Descriptor &desc,
+                                                        const std::string &context)
+    {
+        return new EffectInstance(plugin, desc, context);
+    }
+
+    OFX::Host::ImageEffect::Descriptor *Host::makeDescriptor(OFX::Host::ImageEffect::ImageEffectPlugin *plugin)
+    {
+        return new OFX::Host::ImageEffect::Descriptor(plugin);
+    }
+
+    OFX::Host::ImageEffect::Descriptor *Host::makeDescriptor(const OFX::Host::ImageEffect::Descriptor &rootContext,
+                                                             OFX::Host::ImageEffect::ImageEffectPlugin *plugin)
+    {
+        return new OFX::Host::ImageEffect::Descriptor(rootContext, plugin);
+    }
+
+    OFX::Host::ImageEffect::Descriptor *Host::makeDescriptor(const std::string &bundlePath,
+                                                             OFX::Host::ImageEffect::ImageEffectPlugin *plugin)
+    {
+        return new OFX::Host::ImageEffect::Descriptor(bundlePath, plugin);
+    }
+
+    OfxStatus Host::vmessage(const char *type, const char *id, const char *format, va_list args)
+    {
+        fprintf(stderr, "%s : ", type);
+        vfprintf(stderr, format, args);
+        fprintf(stderr, "\n");
+        return strcmp(type, kOfxMessageQuestion) == 0 ? kOfxStatReplyYes : kOfxStatOK;
+    }
+
+    OfxStatus Host::setPersistentMessage(const char *type, const char *id, const char *format, va_list args)
+    {
+        return vmessage(type, id, format, args);
+    }
+
+    OfxStatus Host::clearPersistentMessage()
+    {
+        return kOfxStatOK;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // multithread suite, one OS thread per requested slot
+
+    static thread_local unsigned int gThreadIndex = 0;
+    static thread_local bool gIsSpawnedThread = false;
+
+    OfxStatus Host::multiThread(OfxThreadFunctionV1 func, unsigned int nThreads, void *customArg)
+    {
+        if (!func) {
+            return kOfxStatFailed;
+        }
+        nThreads = std::max(1u, std::min(nThreads, _maxThreads));
+        if (nThreads == 1) {
+            func(0, 1, customArg);
+            return kOfxStatOK;
+        }
+
+        std::vector<std::thread> threads;
+        threads.reserve(nThreads);
+        for (unsigned int i = 0; i < nThreads; ++i) {
+            threads.push_back(std::thread([=]() {
+                gThreadIndex = i;
+                gIsSpawnedThread = true;
+                func(i, nThreads, customArg);
+            }));
+        }
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+        return kOfxStatOK;
+    }
+
+    OfxStatus Host::multiThreadNumCPUS(unsigned int *nCPUs) const
+    {
+        if (!nCPUs) {
+            return kOfxStatFailed;
+        }
+        *nCPUs = _maxThreads;
+        return kOfxStatOK;
+    }
+
+    OfxStatus Host::multiThreadIndex(unsigned int *threadIndex) const
+    {
+        if (!threadIndex) {
+            return kOfxStatFailed;
+        }
+        *threadIndex = gThreadIndex;
+        return kOfxStatOK;
+    }
+
+    int Host::multiThreadIsSpawnedThread() const
+    {
+        return gIsSpawnedThread;
+    }
+
+    // OFX mutexes are recursive, may be created locked and may be unlocked by any thread,
+    // which std::recursive_mutex does not allow
+    class Mutex {
+        std::mutex _mutex;
+        std::condition_variable _released;
+        std::thread::id _owner;
+        int _count;
+
+    public:
+        explicit Mutex(int lockCount)
+            : _owner(lockCount > 0 ? std::this_thread::get_id() : std::thread::id()), _count(std::max(lockCount, 0)) {}
+
+        void lock()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            const std::thread::id self = std::this_thread::get_id();
+            while (_count > 0 && _owner != self) {
+                _released.wait(lock);
+            }
+            _owner = self;
+            ++_count;
+        }
+
+        bool tryLock()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const std::thread::id self = std::this_thread::get_id();
+            if (_count > 0 && _owner != self) {
+                return false;
+            }
+            _owner = self;
+            ++_count;
+            return true;
+        }
+
+        bool unlock()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_count == 0) {
+                return false;
+            }
+            if (--_count == 0) {
+                _owner = std::thread::id();
+                _released.notify_one();
+            }
+            return true;
+        }
+    };
+
+    OfxStatus Host::mutexCreate(OfxMutexHandle *mutex, int lockCount)
+    {
+        if (!mutex) {
+            return kOfxStatFailed;
+        }
+        *mutex = (OfxMutexHandle)new Mutex(lockCount);
+        return kOfxStatOK;
+    }
+
+    OfxStatus Host::mutexDestroy(const OfxMutexHandle mutex)
+    {
+        if (!mutex) {
+            return kOfxStatErrBadHandle;
+        }
+        delete (Mutex *)mutex;
+        return kOfxStatOK;
+    }
+
+    OfxStatus Host::mutexLock(const OfxMutexHandle mutex)
+    {
+        if (!mutex) {
+            return kOfxStatErrBadHandle;
+        }
+        ((Mutex *)mutex)->lock();
+        return kOfxStatOK;
+    }
+
+    OfxStatus Host::mutexUnLock(const OfxMutexHandle mutex)
+    {
+        if (!mutex) {
+            return kOfxStatErrBadHandle;
+        }
+        return ((Mutex *)mutex)->unlock() ? kOfxStatOK : kOfxStatFailed;
+    }
+
+    OfxStatus Host::mutexTryLock(const OfxMutexHandle mutex)
+    {
+        if (!mutex) {
+            return kOfxStatErrBadHandle;
+        }
+        return ((Mutex *)mutex)->tryLock() ? kOfxStatOK : kOfxStatFailed;
+    }
+
+}
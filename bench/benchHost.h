@@ -0,0 +1,168 @@
+#pragma once
+
+// Minimal headless OFX host used by fluidswirl_bench. Derived from
+// openfx/HostSupport/examples/hostDemo*, but with real parameter storage,
+// synthetic frames of any size/depth and a thread-count limit.
+
+#include <string>
+#include <vector>
+
+// ofx
+#include "ofxCore.h"
+#include "ofxImageEffect.h"
+#include "ofxPixels.h"
+
+// ofx host
+#include "ofxhBinary.h"
+#include "ofxhPropertySuite.h"
+#include "ofxhClip.h"
+#include "ofxhParam.h"
+#include "ofxhMemory.h"
+#include "ofxhImageEffect.h"
+#include "ofxhPluginAPICache.h"
+#include "ofxhPluginCache.h"
+#include "ofxhHost.h"
+#include "ofxhImageEffectAPI.h"
+
+namespace BenchHost {
+
+    // Frame format shared by the source and output clips
+    struct FrameFormat {
+        int width;
+        int height;
+        std::string bitDepth;    // kOfxBitDepthByte, kOfxBitDepthShort, kOfxBitDepthHalf or kOfxBitDepthFloat
+        std::string components;  // kOfxImageComponentRGBA, kOfxImageComponentRGB or kOfxImageComponentAlpha
+
+        int bytesPerComponent() const;
+        int componentCount() const;
+        int bytesPerPixel() const { return bytesPerComponent() * componentCount(); }
+        int rowBytes() const { return width * bytesPerPixel(); }
+        size_t frameBytes() const { return (size_t)rowBytes() * height; }
+    };
+
+    class EffectInstance;
+    class ClipInstance;
+
+    // An image that points into a clip's persistent frame buffer, so fetching
+    // images never allocates pixel memory inside the timed render loop.
+    class Image : public OFX::Host::ImageEffect::Image {
+    public:
+        Image(ClipInstance &clip, const FrameFormat &format, unsigned char *frame, const OfxRectI &bounds);
+    };
+
+    class ClipInstance : public OFX::Host::ImageEffect::ClipInstance {
+    protected:
+        EffectInstance *_effect;
+        std::string _name;
+        std::vector<unsigned char> _frame;
+        OfxRectI _fetchBounds;
+
+    public:
+        ClipInstance(EffectInstance *effect, OFX::Host::ImageEffect::ClipDescriptor *desc);
+
+        bool isOutput() const { return _name == kOfxImageEffectOutputClipName; }
+
+        /// (re)allocate the frame buffer, sources get a deterministic test pattern
+        void allocateFrame();
+        const std::vector<unsigned char> &getFrame() const { return _frame; }
+
+        /// bounds handed out by the next getImage, set from the RoI / render window
+        void setFetchBounds(const OfxRectI &bounds) { _fetchBounds = bounds; }
+
+        virtual const std::string &getUnmappedBitDepth() const;
+        virtual const std::string &getUnmappedComponents() const;
+        virtual const std::string &getPremult() const;
+        virtual double getAspectRatio() const;
+        virtual double getFrameRate() const;
+        virtual void getFrameRange(double &startFrame, double &endFrame) const;
+        virtual const std::string &getFieldOrder() const;
+        virtual bool getConnected() const;
+        virtual double getUnmappedFrameRate() const;
+        virtual void getUnmappedFrameRange(double &unmappedStartFrame, double &unmappedEndFrame) const;
+        virtual bool getContinuousSamples() const;
+        virtual OFX::Host::ImageEffect::Image *getImage(OfxTime time, const OfxRectD *optionalBounds);
+        virtual OfxRectD getRegionOfDefinition(OfxTime time) const;
+    };
+
+    class EffectInstance : public OFX::Host::ImageEffect::Instance {
+    protected:
+        FrameFormat _format;
+
+    public:
+        EffectInstance(OFX::Host::ImageEffect::ImageEffectPlugin *plugin,
+                       OFX::Host::ImageEffect::Descriptor &desc,
+                       const std::string &context);
+
+        const FrameFormat &getFormat() const { return _format; }
+        void setFormat(const FrameFormat &format) { _format = format; }
+
+        ClipInstance *getBenchClip(const std::string &name) { return dynamic_cast<ClipInstance *>(getClip(name)); }
+
+        /// set parameter values by name, returns false if the name or type does not match
+        bool setDouble(const std::string &name, double v);
+        bool setDouble2D(const std::string &name, double x, double y);
+        bool setInt(const std::string &name, int v);
+        bool setChoice(const std::string &name, int v);
+        bool setBoolean(const std::string &name, bool v);
+
+        virtual OFX::Host::ImageEffect::ClipInstance *newClipInstance(OFX::Host::ImageEffect::Instance *plugin,
+                                                                      OFX::Host::ImageEffect::ClipDescriptor *descriptor,
+                                                                      int index);
+        virtual const std::string &getDefaultOutputFielding() const;
+        virtual OfxStatus vmessage(const char *type, const char *id, const char *format, va_list args);
+        virtual OfxStatus setPersistentMessage(const char *type, const char *id, const char *format, va_list args);
+        virtual OfxStatus clearPersistentMessage();
+        virtual void getProjectSize(double &xSize, double &ySize) const;
+        virtual void getProjectOffset(double &xOffset, double &yOffset) const;
+        virtual void getProjectExtent(double &xSize, double &ySize) const;
+        virtual double getProjectPixelAspectRatio() const;
+        virtual double getEffectDuration() const;
+        virtual double getFrameRate() const;
+        virtual double getFrameRecursive() const;
+        virtual void getRenderScaleRecursive(double &x, double &y) const;
+        virtual OFX::Host::Param::Instance *newParam(const std::string &name, OFX::Host::Param::Descriptor &descriptor);
+        virtual OfxStatus editBegin(const std::string &name);
+        virtual OfxStatus editEnd();
+        virtual void progressStart(const std::string &message, const std::string &messageid);
+        virtual void progressEnd();
+        virtual bool progressUpdate(double t);
+        virtual double timeLineGetTime();
+        virtual void timeLineGotoTime(double t);
+        virtual void timeLineGetBounds(double &t1, double &t2);
+    };
+
+    class Host : public OFX::Host::ImageEffect::Host {
+    protected:
+        unsigned int _maxThreads;
+
+    public:
+        Host();
+
+        /// limit the number of threads reported to and used by plugins
+        void setMaxThreads(unsigned int n) { _maxThreads = n > 0 ? n : 1; }
+
+        virtual OFX::Host::ImageEffect::Instance *newInstance(void *clientData,
+                                                              OFX::Host::ImageEffect::ImageEffectPlugin *plugin,
+                                                              OFX::Host::ImageEffect::Descriptor &desc,
+                                                              const std::string &context);
+        virtual OFX::Host::ImageEffect::Descriptor *makeDescriptor(OFX::Host::ImageEffect::ImageEffectPlugin *plugin);
+        virtual OFX::Host::ImageEffect::Descriptor *makeDescriptor(const OFX::Host::ImageEffect::Descriptor &rootContext,
+                                                                   OFX::Host::ImageEffect::ImageEffectPlugin *plugin);
+        virtual OFX::Host::ImageEffect::Descriptor *makeDescriptor(const std::string &bundlePath,
+                                                                   OFX::Host::ImageEffect::ImageEffectPlugin *plugin);
+        virtual OfxStatus vmessage(const char *type, const char *id, const char *format, va_list args);
+        virtual OfxStatus setPersistentMessage(const char *type, const char *id, const char *format, va_list args);
+        virtual OfxStatus clearPersistentMessage();
+
+        virtual OfxStatus multiThread(OfxThreadFunctionV1 func, unsigned int nThreads, void *customArg);
+        virtual OfxStatus multiThreadNumCPUS(unsigned int *nCPUs) const;
+        virtual OfxStatus multiThreadIndex(unsigned int *threadIndex) const;
+        virtual int multiThreadIsSpawnedThread() const;
+        virtual OfxStatus mutexCreate(OfxMutexHandle *mutex, int lockCount);
+        virtual OfxStatus mutexDestroy(const OfxMutexHandle mutex);
+        virtual OfxStatus mutexLock(const OfxMutexHandle mutex);
+        virtual OfxStatus mutexUnLock(const OfxMutexHandle mutex);
+        virtual OfxStatus mutexTryLock(const OfxMutexHandle mutex);
+    };
+
+}
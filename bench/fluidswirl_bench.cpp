@@ -0,0 +1,468 @@
+// fluidswirl_bench - headless benchmark host for the FluidSwirl OFX plugin.
+//
+// Loads FluidSwirl.ofx through HostSupport (like openfx/HostSupport/examples/hostDemo),
+// feeds it synthetic frames and times render actions for every flow mode and
+// parameter preset across a list of thread counts. Runs fully offline.
+//
+//   fluidswirl_bench [--plugin-dir DIR] [--size 3840x2160] [--depth 8|16|half|32]
+//                    [--components rgba|rgb|alpha] [--modes 0,1,2] [--presets default,localized,strong]
+//                    [--threads 1,2,4] [--frames 5] [--time 10] [--tile N]
+//                    [--set name=value]... [--dump FILE] [--compare FILE] [--plugin-cache FILE]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchHost.h"
+
+#ifndef FLUIDSWIRL_BENCH_PLUGIN_DIR
+#define FLUIDSWIRL_BENCH_PLUGIN_DIR "."
+#endif
+
+#define kFluidSwirlPluginIdentifier "com.resolve.fluidswirl"
+
+namespace {
+
+    struct Options {
+        std::string pluginDir;
+        BenchHost::FrameFormat format;
+        std::vector<int> modes;
+        std::vector<std::string> presets;
+        std::vector<unsigned int> threads;
+        int frames;
+        double time;
+        int tile;
+        std::vector<std::pair<std::string, std::string> > overrides;
+        std::string dumpFile;
+        std::string compareFile;
+        std::string pluginCacheFile;
+    };
+
+    struct Preset {
+        const char *name;
+        double swirlIntensity;
+        double radius;
+        double decay;
+        double flowStrength;
+        double wakeWidth;
+        double projectileRadius;
+    };
+
+    // "default" matches the plugin defaults, "localized" keeps the effect to a
+    // small part of the frame, "strong" maxes out the displacement
+    const Preset kPresets[] = {
+        { "default",   1.0, 200.0, 100.0, 1.0,  50.0,  80.0 },
+        { "localized", 1.0,  40.0,  20.0, 0.5,  10.0,  20.0 },
+        { "strong",    8.0, 800.0, 400.0, 8.0, 180.0, 250.0 },
+    };
+
+    const Preset *findPreset(const std::string &name)
+    {
+        for (size_t i = 0; i < sizeof(kPresets) / sizeof(kPresets[0]); ++i) {
+            if (name == kPresets[i].name) {
+                return &kPresets[i];
+            }
+        }
+        return 0;
+    }
+
+    std::vector<std::string> split(const std::string &s, char sep)
+    {
+        std::vector<std::string> out;
+        std::stringstream ss(s);
+        std::string item;
+        while (std::getline(ss, item, sep)) {
+            if (!item.empty()) {
+                out.push_back(item);
+            }
+        }
+        return out;
+    }
+
+    void usage()
+    {
+        fprintf(stderr,
+                "usage: fluidswirl_bench [options]\n"
+                "  --plugin-dir DIR        directory containing FluidSwirl.ofx.bundle\n"
+                "  --size WxH              frame size (default 3840x2160)\n"
+                "  --depth 8|16|half|32    bit depth (default 8)\n"
+                "  --components rgba|rgb|alpha (default rgba)\n"
+                "  --modes LIST            flow modes to run, e.g. 0,2 (default 0,1,2)\n"
+                "  --presets LIST          default,localized,strong (default all)\n"
+                "  --threads LIST          thread counts (default 1,2,4,... up to the core count)\n"
+                "  --frames N              timed renders per configuration (default 5)\n"
+                "  --time T                frame time passed to render (default 10)\n"
+                "  --tile N                render in NxN windows with per-tile regions of interest\n"
+                "  --set NAME=VALUE        override a double, int or choice parameter\n"
+                "  --dump FILE             write the last rendered output frame to FILE\n"
+                "  --compare FILE          compare the last rendered output frame against FILE\n"
+                "  --plugin-cache FILE     load the plugins from the binary plugin cache FILE, and\n"
+                "                          write it when it is missing or out of date\n");
+    }
+
+    bool parseArgs(int argc, char **argv, Options &opt)
+    {
+        opt.pluginDir = FLUIDSWIRL_BENCH_PLUGIN_DIR;
+        opt.format.width = 3840;
+        opt.format.height = 2160;
+        opt.format.bitDepth = kOfxBitDepthByte;
+        opt.format.components = kOfxImageComponentRGBA;
+        opt.frames = 5;
+        opt.time = 10.0;
+        opt.tile = 0;
+
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                return false;
+            }
+            if (i + 1 >= argc) {
+                fprintf(stderr, "missing value for %s\n", arg.c_str());
+                return false;
+            }
+            const std::string value = argv[++i];
+
+            if (arg == "--plugin-dir") {
+                opt.pluginDir = value;
+            } else if (arg == "--size") {
+                if (sscanf(value.c_str(), "%dx%d", &opt.format.width, &opt.format.height) != 2 ||
+                    opt.format.width <= 0 || opt.format.height <= 0) {
+                    fprintf(stderr, "bad --size %s\n", value.c_str());
+                    return false;
+                }
+            } else if (arg == "--depth") {
+                if (value == "8") opt.format.bitDepth = kOfxBitDepthByte;
+                else if (value == "16") opt.format.bitDepth = kOfxBitDepthShort;
+                else if (value == "half") opt.format.bitDepth = kOfxBitDepthHalf;
+                else if (value == "32") opt.format.bitDepth = kOfxBitDepthFloat;
+                else { fprintf(stderr, "bad --depth %s\n", value.c_str()); return false; }
+            } else if (arg == "--components") {
+                if (value == "rgba") opt.format.components = kOfxImageComponentRGBA;
+                else if (value == "rgb") opt.format.components = kOfxImageComponentRGB;
+                else if (value == "alpha") opt.format.components = kOfxImageComponentAlpha;
+                else { fprintf(stderr, "bad --components %s\n", value.c_str()); return false; }
+            } else if (arg == "--modes") {
+                std::vector<std::string> items = split(value, ',');
+                for (size_t j = 0; j < items.size(); ++j) {
+                    opt.modes.push_back(atoi(items[j].c_str()));
+                }
+            } else if (arg == "--presets") {
+                opt.presets = split(value, ',');
+                for (size_t j = 0; j < opt.presets.size(); ++j) {
+                    if (!findPreset(opt.presets[j])) {
+                        fprintf(stderr, "unknown preset %s\n", opt.presets[j].c_str());
+                        return false;
+                    }
+                }
+            } else if (arg == "--threads") {
+                std::vector<std::string> items = split(value, ',');
+                for (size_t j = 0; j < items.size(); ++j) {
+                    opt.threads.push_back((unsigned int)std::max(1, atoi(items[j].c_str())));
+                }
+            } else if (arg == "--frames") {
+                opt.frames = std::max(1, atoi(value.c_str()));
+            } else if (arg == "--time") {
+                opt.time = atof(value.c_str());
+            } else if (arg == "--tile") {
+                opt.tile = std::max(0, atoi(value.c_str()));
+            } else if (arg == "--set") {
+                const size_t eq = value.find('=');
+                if (eq == std::string::npos) {
+                    fprintf(stderr, "bad --set %s, expected NAME=VALUE\n", value.c_str());
+                    return false;
+                }
+                opt.overrides.push_back(std::make_pair(value.substr(0, eq), value.substr(eq + 1)));
+            } else if (arg == "--dump") {
+                opt.dumpFile = value;
+            } else if (arg == "--compare") {
+                opt.compareFile = value;
+            } else if (arg == "--plugin-cache") {
+                opt.pluginCacheFile = value;
+            } else {
+                fprintf(stderr, "unknown option %s\n", arg.c_str());
+                return false;
+            }
+        }
+
+        if (opt.modes.empty()) {
+            opt.modes.push_back(0);
+            opt.modes.push_back(1);
+            opt.modes.push_back(2);
+        }
+        if (opt.presets.empty()) {
+            for (size_t i = 0; i < sizeof(kPresets) / sizeof(kPresets[0]); ++i) {
+                opt.presets.push_back(kPresets[i].name);
+            }
+        }
+        if (opt.threads.empty()) {
+            const unsigned int hw = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned int n = 1; n < hw; n *= 2) {
+                opt.threads.push_back(n);
+            }
+            opt.threads.push_back(hw);
+        }
+        return true;
+    }
+
+    void applyOverride(BenchHost::EffectInstance &instance, const std::string &name, const std::string &value)
+    {
+        const double v = atof(value.c_str());
+        if (instance.setDouble(name, v) || instance.setInt(name, (int)v) ||
+            instance.setChoice(name, (int)v) || instance.setBoolean(name, v != 0.0)) {
+            return;
+        }
+        fprintf(stderr, "warning: --set %s ignored, no double, int, choice or boolean parameter of that name\n", name.c_str());
+    }
+
+    // Renders one frame, either as a single render window or as a grid of tiles
+    // with a region of interest request per tile, like a tiling host would.
+    OfxStatus renderFrame(BenchHost::EffectInstance &instance, const Options &opt)
+    {
+        const BenchHost::FrameFormat &format = instance.getFormat();
+        BenchHost::ClipInstance *srcClip = instance.getBenchClip(kOfxImageEffectSimpleSourceClipName);
+        OfxPointD renderScale;
+        renderScale.x = renderScale.y = 1.0;
+
+        const int tile = opt.tile > 0 ? opt.tile : std::max(format.width, format.height);
+        for (int y = 0; y < format.height; y += tile) {
+            for (int x = 0; x < format.width; x += tile) {
+                OfxRectI window;
+                window.x1 = x;
+                window.y1 = y;
+                window.x2 = std::min(x + tile, format.width);
+                window.y2 = std::min(y + tile, format.height);
+
+                OfxRectD roi;
+                roi.x1 = window.x1;
+                roi.y1 = window.y1;
+                roi.x2 = window.x2;
+                roi.y2 = window.y2;
+                std::map<OFX::Host::ImageEffect::ClipInstance *, OfxRectD> rois;
+                OfxStatus stat = instance.getRegionOfInterestAction(opt.time, renderScale, roi, rois);
+                if (stat != kOfxStatOK && stat != kOfxStatReplyDefault) {
+                    return stat;
+                }
+                std::map<OFX::Host::ImageEffect::ClipInstance *, OfxRectD>::const_iterator it = rois.find(srcClip);
+                OfxRectI fetch;
+                if (it != rois.end()) {
+                    fetch.x1 = (int)std::floor(it->second.x1);
+                    fetch.y1 = (int)std::floor(it->second.y1);
+                    fetch.x2 = (int)std::ceil(it->second.x2);
+                    fetch.y2 = (int)std::ceil(it->second.y2);
+                } else {
+                    fetch = window;
+                }
+                srcClip->setFetchBounds(fetch);
+
+                stat = instance.renderAction(opt.time, kOfxImageFieldNone, window, renderScale,
+                                             /*sequentialRender=*/true, /*interactiveRender=*/false,
+                                             /*draftRender=*/false);
+                if (stat != kOfxStatOK) {
+                    return stat;
+                }
+            }
+        }
+        return kOfxStatOK;
+    }
+
+    double halfToDouble(unsigned short h)
+    {
+        const int exponent = (h >> 10) & 0x1f;
+        const int mantissa = h & 0x3ff;
+        double value;
+        if (exponent == 0) {
+            value = std::ldexp((double)mantissa, -24);
+        } else if (exponent == 31) {
+            value = mantissa ? std::numeric_limits<double>::quiet_NaN() : std::numeric_limits<double>::infinity();
+        } else {
+            value = std::ldexp((double)(mantissa | 0x400), exponent - 25);
+        }
+        return (h & 0x8000) ? -value : value;
+    }
+
+    bool compareFrames(const BenchHost::FrameFormat &format, const std::vector<unsigned char> &frame, const std::string &file)
+    {
+        std::ifstream is(file.c_str(), std::ios::binary);
+        std::vector<unsigned char> ref((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+        if (ref.size() != frame.size()) {
+            fprintf(stderr, "compare: %s has %zu bytes, expected %zu\n", file.c_str(), ref.size(), frame.size());
+            return false;
+        }
+
+        const size_t nValues = frame.size() / format.bytesPerComponent();
+        double maxDiff = 0.0, sumDiff = 0.0;
+        size_t nDiffering = 0;
+        for (size_t i = 0; i < nValues; ++i) {
+            double a, b;
+            if (format.bytesPerComponent() == 1) {
+                a = frame[i];
+                b = ref[i];
+            } else if (format.bitDepth == kOfxBitDepthHalf) {
+                a = halfToDouble(((const unsigned short *)&frame[0])[i]);
+                b = halfToDouble(((const unsigned short *)&ref[0])[i]);
+            } else if (format.bytesPerComponent() == 2) {
+                a = ((const unsigned short *)&frame[0])[i];
+                b = ((const unsigned short *)&ref[0])[i];
+            } else {
+                a = ((const float *)&frame[0])[i];
+                b = ((const float *)&ref[0])[i];
+            }
+            const double d = std::fabs(a - b);
+            if (d > 0.0) {
+                ++nDiffering;
+            }
+            maxDiff = std::max(maxDiff, d);
+            sumDiff += d;
+        }
+        printf("compare: %zu of %zu values differ, max abs diff %g, mean abs diff %g\n",
+               nDiffering, nValues, maxDiff, nValues ? sumDiff / nValues : 0.0);
+        return true;
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        usage();
+        return 1;
+    }
+
+    // only look where we are told to, and skip the on-disk cache unless asked for one
+    const std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+    OFX::Host::PluginCache::useStdOFXPluginsLocation(false);
+    OFX::Host::PluginCache::getPluginCache()->setCacheVersion("fluidswirlBenchV1");
+    OFX::Host::PluginCache::getPluginCache()->addFileToPath(opt.pluginDir);
+
+    BenchHost::Host host;
+    OFX::Host::ImageEffect::PluginCache imageEffectPluginCache(&host);
+    imageEffectPluginCache.registerInCache(*OFX::Host::PluginCache::getPluginCache());
+    const bool cacheRead = !opt.pluginCacheFile.empty() &&
+                           OFX::Host::PluginCache::getPluginCache()->readBinaryCache(opt.pluginCacheFile);
+    OFX::Host::PluginCache::getPluginCache()->scanPluginFiles();
+    if (!opt.pluginCacheFile.empty()) {
+        const bool rebuilt = !cacheRead || OFX::Host::PluginCache::getPluginCache()->dirty();
+        if (rebuilt && !OFX::Host::PluginCache::getPluginCache()->writeBinaryCache(opt.pluginCacheFile)) {
+            fprintf(stderr, "warning: could not write the plugin cache %s\n", opt.pluginCacheFile.c_str());
+        }
+        printf("plugin cache %s %s, plugins loaded in %.3f ms\n", opt.pluginCacheFile.c_str(), rebuilt ? "rebuilt" : "used",
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count());
+    }
+
+    OFX::Host::ImageEffect::ImageEffectPlugin *plugin = imageEffectPluginCache.getPluginById(kFluidSwirlPluginIdentifier);
+    if (!plugin) {
+        fprintf(stderr, "could not find %s in %s\n", kFluidSwirlPluginIdentifier, opt.pluginDir.c_str());
+        OFX::Host::PluginCache::clearPluginCache();
+        return 1;
+    }
+
+    int result = 0;
+    {
+        OFX::Host::auto_ptr<OFX::Host::ImageEffect::Instance> base(plugin->createInstance(kOfxImageEffectContextFilter, NULL));
+        BenchHost::EffectInstance *instance = dynamic_cast<BenchHost::EffectInstance *>(base.get());
+        if (!instance) {
+            fprintf(stderr, "could not create a filter instance\n");
+            OFX::Host::PluginCache::clearPluginCache();
+            return 1;
+        }
+
+        instance->setFormat(opt.format);
+        instance->getBenchClip(kOfxImageEffectSimpleSourceClipName)->allocateFrame();
+        instance->getBenchClip(kOfxImageEffectOutputClipName)->allocateFrame();
+
+        OfxStatus stat = instance->createInstanceAction();
+        if ((stat != kOfxStatOK && stat != kOfxStatReplyDefault) || !instance->getClipPreferences()) {
+            fprintf(stderr, "createInstance failed (%d)\n", stat);
+            OFX::Host::PluginCache::clearPluginCache();
+            return 1;
+        }
+
+        // HostSupport maps a single alpha input to an RGBA output, but the
+        // benchmark frames (and the plugin's render dispatch) are the source
+        // format, so keep the output clip on exactly that format.
+        instance->getBenchClip(kOfxImageEffectOutputClipName)->setComponents(opt.format.components);
+        instance->getBenchClip(kOfxImageEffectOutputClipName)->setPixelDepth(opt.format.bitDepth);
+
+        const double nPixels = (double)opt.format.width * opt.format.height;
+        printf("FluidSwirl benchmark: %dx%d %s %s, %d frame(s) per configuration%s\n",
+               opt.format.width, opt.format.height, opt.format.bitDepth.c_str(), opt.format.components.c_str(),
+               opt.frames, opt.tile > 0 ? ", tiled" : "");
+        printf("%-5s %-10s %8s %12s %10s %10s %8s\n", "mode", "preset", "threads", "ms/frame", "ns/pixel", "frames/s", "scaling");
+
+        OfxPointD renderScale;
+        renderScale.x = renderScale.y = 1.0;
+
+        for (size_t m = 0; m < opt.modes.size() && result == 0; ++m) {
+            for (size_t p = 0; p < opt.presets.size() && result == 0; ++p) {
+                const Preset *preset = findPreset(opt.presets[p]);
+                instance->setChoice("flowMode", opt.modes[m]);
+                instance->setDouble("swirlIntensity", preset->swirlIntensity);
+                instance->setDouble("radius", preset->radius);
+                instance->setDouble("decay", preset->decay);
+                instance->setDouble("flowStrength", preset->flowStrength);
+                instance->setDouble("wakeWidth", preset->wakeWidth);
+                instance->setDouble("projectileRadius", preset->projectileRadius);
+                for (size_t o = 0; o < opt.overrides.size(); ++o) {
+                    applyOverride(*instance, opt.overrides[o].first, opt.overrides[o].second);
+                }
+
+                double baselineSeconds = 0.0;
+                for (size_t t = 0; t < opt.threads.size() && result == 0; ++t) {
+                    host.setMaxThreads(opt.threads[t]);
+
+                    instance->beginRenderAction(opt.time, opt.time, 1.0, false, renderScale, true, false, false);
+
+                    // one untimed render to warm caches and first-touch the output
+                    stat = renderFrame(*instance, opt);
+
+                    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    for (int f = 0; f < opt.frames && stat == kOfxStatOK; ++f) {
+                        stat = renderFrame(*instance, opt);
+                    }
+                    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / opt.frames;
+
+                    instance->endRenderAction(opt.time, opt.time, 1.0, false, renderScale, true, false, false);
+
+                    if (stat != kOfxStatOK) {
+                        fprintf(stderr, "render failed (%d) for mode %d preset %s\n", stat, opt.modes[m], preset->name);
+                        result = 1;
+                        break;
+                    }
+                    // scaling is relative to the first thread count in the list
+                    if (t == 0) {
+                        baselineSeconds = seconds;
+                    }
+                    printf("%-5d %-10s %8u %12.3f %10.3f %10.2f %7.2fx\n",
+                           opt.modes[m], preset->name, opt.threads[t], seconds * 1e3, seconds * 1e9 / nPixels,
+                           1.0 / seconds, baselineSeconds / seconds);
+                }
+            }
+        }
+
+        const std::vector<unsigned char> &output = instance->getBenchClip(kOfxImageEffectOutputClipName)->getFrame();
+        if (result == 0 && !opt.dumpFile.empty()) {
+            std::ofstream os(opt.dumpFile.c_str(), std::ios::binary);
+            os.write((const char *)&output[0], output.size());
+            printf("wrote %zu bytes to %s\n", output.size(), opt.dumpFile.c_str());
+        }
+        if (result == 0 && !opt.compareFile.empty() && !compareFrames(opt.format, output, opt.compareFile)) {
+            result = 1;
+        }
+
+        instance->destroyInstanceAction();
+    }
+
+    OFX::Host::PluginCache::clearPluginCache();
+    return result;
+}
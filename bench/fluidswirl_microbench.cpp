@@ -0,0 +1,321 @@
+// fluidswirl_microbench - google-benchmark suite for the FluidSwirl per-pixel kernels.
+//
+// Runs FluidSwirlKernel (what the plugin's processor calls for every tile) directly on
+// in-memory frames, single threaded, for all 12 pixel formats x 3 flow modes, with the
+// effect covering a small part of the frame ("sparse") or all of it ("dense"), and with the
+// displacement computed per frame, computed on the adaptive 4x4 or 8x8 grid, or read from a
+// ready cache (resampling only).
+//
+//   fluidswirl_microbench --benchmark_filter=Mode2 --benchmark_out=results.json --benchmark_out_format=json
+//
+// Benchmark names read Format/Mode/Coverage/Displacement, e.g. RGBA16/Mode2/dense/computed,
+// with a /double suffix when the kernel is forced to double precision (it picks float for
+// these frames otherwise) and an /antialiased one with the mip pyramid filtering on. items_per_second is pixels per second, per_pixel the time per
+// pixel in seconds. The half float formats (RGBAh etc.) use the F16C taps when the CPU
+// has them, like the plugin.
+//
+//   fluidswirl_microbench --validate
+//
+// renders every configuration once in float and once in double instead and prints how far
+// apart the two are, per format: the largest and mean difference of the output values (in
+// code values for the integer formats) and the largest difference of the displacement.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "FluidSwirlHalf.hpp"
+
+namespace {
+
+    const int kFrameWidth = 1280;
+    const int kFrameHeight = 720;
+    const int kTileSize = 64;
+
+    enum Coverage { eSparse, eDense };
+    enum Displacement { eComputed, eAdaptive4, eAdaptive8, eCached };
+
+    // Plugin defaults ("sparse" shrinks the effect to a small area, "dense" spreads it over
+    // the whole frame), converted to pixels the way FluidSwirlPlugin::getPixelParams does
+    FluidSwirlParams makeParams(int flowMode, Coverage coverage)
+    {
+        const double scale = sqrt((double)kFrameWidth * kFrameWidth + (double)kFrameHeight * kFrameHeight) /
+                             sqrt(1920.0 * 1920.0 + 1080.0 * 1080.0);
+        const bool dense = coverage == eDense;
+
+        FluidSwirlParams p;
+        p.swirlIntensity = dense ? 8.0 : 1.0;
+        p.centerX = 0.5 * kFrameWidth;
+        p.centerY = 0.5 * kFrameHeight;
+        p.radius = (dense ? 800.0 : 40.0) * scale;
+        p.decay = (dense ? 400.0 : 20.0) * scale;
+        p.flowDirection = 30.0;
+        p.flowStrength = dense ? 8.0 : 0.5;
+        p.wakeWidth = (dense ? 180.0 : 10.0) * scale;
+        p.vortexSpacing = 80.0 * scale;
+        p.flowMode = flowMode;
+        p.projectileStartX = 0.1 * kFrameWidth;
+        p.projectileStartY = 0.5 * kFrameHeight;
+        p.projectileEndX = 0.9 * kFrameWidth;
+        p.projectileEndY = 0.5 * kFrameHeight;
+        p.projectileSpeed = 30.0;
+        p.projectileRadius = (dense ? 250.0 : 20.0) * scale;
+        p.wakeDecay = 0.5;
+        p.time = 10.0;
+        return p;
+    }
+
+    // Smooth gradients plus a fine checker, so every resampling tap sees varying values
+    template <class PIX, int nComponents, int maxValue>
+    void fillSource(std::vector<PIX> &pixels)
+    {
+        pixels.resize((size_t)kFrameWidth * kFrameHeight * nComponents);
+        for (int y = 0; y < kFrameHeight; y++) {
+            for (int x = 0; x < kFrameWidth; x++) {
+                PIX *pix = &pixels[((size_t)y * kFrameWidth + x) * nComponents];
+                const double checker = ((x >> 3) + (y >> 3)) & 1 ? 0.1 : 0.0;
+                for (int c = 0; c < nComponents; c++) {
+                    const double v = 0.45 * (c & 1 ? (double)y / kFrameHeight : (double)x / kFrameWidth) + 0.45 * (c == 3) + checker;
+                    pix[c] = (PIX)(v * maxValue);
+                }
+            }
+        }
+    }
+
+    template <class PIX, int nComponents, int maxValue, int flowMode>
+    void BM_Kernel(benchmark::State &state, Coverage coverage, Displacement displacement,
+                   FluidSwirlKernelBase::ComputePrecision precision, bool antialiasing)
+    {
+        std::vector<PIX> src, dst((size_t)kFrameWidth * kFrameHeight * nComponents);
+        fillSource<PIX, nComponents, maxValue>(src);
+
+        const OfxRectI frame = { 0, 0, kFrameWidth, kFrameHeight };
+        const int pixelBytes = nComponents * (int)sizeof(PIX);
+
+        FluidSwirlKernel<PIX, nComponents, maxValue, flowMode> kernel;
+        kernel.setSrcImage(OFX::ConstImageView((const char *) &src[0], frame, kFrameWidth * pixelBytes, pixelBytes), frame);
+        kernel.setDstImage(OFX::ImageView((char *) &dst[0], frame, kFrameWidth * pixelBytes, pixelBytes));
+        kernel.setUseSIMD(true);
+        kernel.setDisplacementGrid(displacement == eAdaptive4 ? 4 : displacement == eAdaptive8 ? 8 : 1);
+        kernel.setComputePrecision(precision);
+        kernel.setAntialiasing(antialiasing);
+        kernel.setSwirlParams(makeParams(flowMode, coverage));
+        kernel.prepareSource();
+
+        // A cached run fills the field once outside the timed loop
+        FluidSwirlDisplacementField field;
+        if (displacement == eCached) {
+            const size_t nPixels = (size_t)kFrameWidth * kFrameHeight;
+            field.bounds = frame;
+            field.offsets.resize(2 * nPixels);
+            field.wakeBlur.resize(flowMode == 2 ? nPixels : 0);
+            kernel.setDisplacementField(&field, false);
+            kernel.processTile(frame);
+            kernel.setDisplacementField(&field, true);
+        }
+
+        for (auto _ : state) {
+            // once per render, like the plugin
+            kernel.prepareSource();
+            for (int y = 0; y < kFrameHeight; y += kTileSize) {
+                for (int x = 0; x < kFrameWidth; x += kTileSize) {
+                    const OfxRectI tile = { x, y, std::min(x + kTileSize, kFrameWidth), std::min(y + kTileSize, kFrameHeight) };
+                    kernel.processTile(tile);
+                }
+            }
+            benchmark::DoNotOptimize(&dst[0]);
+            benchmark::ClobberMemory();
+        }
+
+        const int64_t pixels = (int64_t)kFrameWidth * kFrameHeight;
+        state.SetItemsProcessed(state.iterations() * pixels);
+        state.SetBytesProcessed(state.iterations() * pixels * pixelBytes);
+        state.counters["per_pixel"] = benchmark::Counter((double)pixels, benchmark::Counter::kIsIterationInvariantRate |
+                                                                          benchmark::Counter::kInvert);
+    }
+
+    template <class PIX, int nComponents, int maxValue, int flowMode>
+    void registerMode(const std::string &format)
+    {
+        static const char *const kCoverage[] = { "sparse", "dense" };
+        static const char *const kDisplacement[] = { "computed", "adaptive4", "adaptive8", "cached" };
+        for (int coverage = eSparse; coverage <= eDense; coverage++) {
+            for (int displacement = eComputed; displacement <= eCached; displacement++) {
+                char name[128];
+                snprintf(name, sizeof(name), "%s/Mode%d/%s/%s", format.c_str(), flowMode,
+                         kCoverage[coverage], kDisplacement[displacement]);
+                benchmark::RegisterBenchmark(name, BM_Kernel<PIX, nComponents, maxValue, flowMode>,
+                                             (Coverage)coverage, (Displacement)displacement,
+                                             FluidSwirlKernelBase::ePrecisionAuto, false)
+                    ->Unit(benchmark::kMillisecond);
+                if (displacement == eComputed || displacement == eCached) {
+                    benchmark::RegisterBenchmark((std::string(name) + "/double").c_str(),
+                                                 BM_Kernel<PIX, nComponents, maxValue, flowMode>,
+                                                 (Coverage)coverage, (Displacement)displacement,
+                                                 FluidSwirlKernelBase::ePrecisionDouble, false)
+                        ->Unit(benchmark::kMillisecond);
+                    benchmark::RegisterBenchmark((std::string(name) + "/antialiased").c_str(),
+                                                 BM_Kernel<PIX, nComponents, maxValue, flowMode>,
+                                                 (Coverage)coverage, (Displacement)displacement,
+                                                 FluidSwirlKernelBase::ePrecisionAuto, true)
+                        ->Unit(benchmark::kMillisecond);
+                }
+            }
+        }
+    }
+
+    template <class PIX, int nComponents, int maxValue>
+    void registerFormat(const std::string &format)
+    {
+        registerMode<PIX, nComponents, maxValue, 0>(format);
+        registerMode<PIX, nComponents, maxValue, 1>(format);
+        registerMode<PIX, nComponents, maxValue, 2>(format);
+    }
+
+    // Half float, with the taps the plugin would pick on this CPU
+    template <int nComponents>
+    void registerHalfFormat(const std::string &format)
+    {
+        if (FluidSwirlSIMD::hasF16C()) {
+            registerFormat<FluidSwirlHalfPixel<true>, nComponents, 1>(format);
+        } else {
+            registerFormat<FluidSwirlHalfPixel<false>, nComponents, 1>(format);
+        }
+    }
+
+    // One whole frame rendered with the displacement computed per pixel, keeping the
+    // displacement it used
+    template <class PIX, int nComponents, int maxValue, int flowMode>
+    void renderFrame(Coverage coverage, FluidSwirlKernelBase::ComputePrecision precision,
+                     const std::vector<PIX> &src, std::vector<PIX> &dst, FluidSwirlDisplacementField &field)
+    {
+        const OfxRectI frame = { 0, 0, kFrameWidth, kFrameHeight };
+        const int pixelBytes = nComponents * (int)sizeof(PIX);
+        const size_t nPixels = (size_t)kFrameWidth * kFrameHeight;
+
+        dst.assign(nPixels * nComponents, 0);
+        field.bounds = frame;
+        field.offsets.assign(2 * nPixels, 0.0f);
+        field.wakeBlur.assign(flowMode == 2 ? nPixels : 0, 0.0f);
+
+        FluidSwirlKernel<PIX, nComponents, maxValue, flowMode> kernel;
+        kernel.setSrcImage(OFX::ConstImageView((const char *) &src[0], frame, kFrameWidth * pixelBytes, pixelBytes), frame);
+        kernel.setDstImage(OFX::ImageView((char *) &dst[0], frame, kFrameWidth * pixelBytes, pixelBytes));
+        kernel.setUseSIMD(true);
+        kernel.setComputePrecision(precision);
+        kernel.setSwirlParams(makeParams(flowMode, coverage));
+        kernel.prepareSource();
+        kernel.setDisplacementField(&field, false);
+        kernel.processTile(frame);
+    }
+
+    template <class PIX, int nComponents, int maxValue, int flowMode>
+    void validateMode(const char *format)
+    {
+        static const char *const kCoverage[] = { "sparse", "dense" };
+        std::vector<PIX> src;
+        fillSource<PIX, nComponents, maxValue>(src);
+
+        for (int coverage = eSparse; coverage <= eDense; coverage++) {
+            std::vector<PIX> single, reference;
+            FluidSwirlDisplacementField singleField, referenceField;
+            renderFrame<PIX, nComponents, maxValue, flowMode>((Coverage)coverage, FluidSwirlKernelBase::ePrecisionSingle,
+                                                              src, single, singleField);
+            renderFrame<PIX, nComponents, maxValue, flowMode>((Coverage)coverage, FluidSwirlKernelBase::ePrecisionDouble,
+                                                              src, reference, referenceField);
+
+            double maxError = 0.0, sumError = 0.0;
+            size_t nDiffering = 0;
+            for (size_t i = 0; i < single.size(); i++) {
+                const double d = std::fabs((double)single[i] - (double)reference[i]);
+                nDiffering += d > 0.0;
+                maxError = std::max(maxError, d);
+                sumError += d;
+            }
+            double maxOffsetError = 0.0;
+            for (size_t i = 0; i < singleField.offsets.size(); i++) {
+                maxOffsetError = std::max(maxOffsetError, std::fabs((double)singleField.offsets[i] - referenceField.offsets[i]));
+            }
+
+            printf("%-9s %4d %-8s %12.4f%% %12g %12g %14g\n", format, flowMode, kCoverage[coverage],
+                   100.0 * nDiffering / single.size(), maxError, sumError / single.size(), maxOffsetError);
+        }
+    }
+
+    template <class PIX, int nComponents, int maxValue>
+    void validateFormat(const char *format)
+    {
+        validateMode<PIX, nComponents, maxValue, 0>(format);
+        validateMode<PIX, nComponents, maxValue, 1>(format);
+        validateMode<PIX, nComponents, maxValue, 2>(format);
+    }
+
+    template <int nComponents>
+    void validateHalfFormat(const char *format)
+    {
+        if (FluidSwirlSIMD::hasF16C()) {
+            validateFormat<FluidSwirlHalfPixel<true>, nComponents, 1>(format);
+        } else {
+            validateFormat<FluidSwirlHalfPixel<false>, nComponents, 1>(format);
+        }
+    }
+
+    void validate()
+    {
+        printf("float against double precision, %dx%d, %s\n", kFrameWidth, kFrameHeight,
+               FluidSwirlSIMD::getInstructionSetName());
+        printf("%-9s %4s %-8s %13s %12s %12s %14s\n", "format", "mode", "coverage", "differing", "max error",
+               "mean error", "max offset px");
+        validateFormat<unsigned char, 4, 255>("RGBA8");
+        validateFormat<unsigned short, 4, 65535>("RGBA16");
+        validateHalfFormat<4>("RGBAh");
+        validateFormat<float, 4, 1>("RGBA32f");
+        validateFormat<unsigned char, 3, 255>("RGB8");
+        validateFormat<unsigned short, 3, 65535>("RGB16");
+        validateHalfFormat<3>("RGBh");
+        validateFormat<float, 3, 1>("RGB32f");
+        validateFormat<unsigned char, 1, 255>("Alpha8");
+        validateFormat<unsigned short, 1, 65535>("Alpha16");
+        validateHalfFormat<1>("Alphah");
+        validateFormat<float, 1, 1>("Alpha32f");
+    }
+
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 2 && strcmp(argv[1], "--validate") == 0) {
+        validate();
+        return 0;
+    }
+
+    registerFormat<unsigned char, 4, 255>("RGBA8");
+    registerFormat<unsigned short, 4, 65535>("RGBA16");
+    registerHalfFormat<4>("RGBAh");
+    registerFormat<float, 4, 1>("RGBA32f");
+    registerFormat<unsigned char, 3, 255>("RGB8");
+    registerFormat<unsigned short, 3, 65535>("RGB16");
+    registerHalfFormat<3>("RGBh");
+    registerFormat<float, 3, 1>("RGB32f");
+    registerFormat<unsigned char, 1, 255>("Alpha8");
+    registerFormat<unsigned short, 1, 65535>("Alpha16");
+    registerHalfFormat<1>("Alphah");
+    registerFormat<float, 1, 1>("Alpha32f");
+
+    benchmark::AddCustomContext("frame", std::to_string(kFrameWidth) + "x" + std::to_string(kFrameHeight));
+    benchmark::AddCustomContext("instruction_set", FluidSwirlSIMD::getInstructionSetName());
+    benchmark::AddCustomContext("half_conversion", FluidSwirlHalf::getConversionName());
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
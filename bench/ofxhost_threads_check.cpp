@@ -0,0 +1,147 @@
+// ofxhost_threads_check - checks the multithread suite HostSupport provides itself, for hosts
+// built without OFX_SUPPORTS_MULTITHREAD (fluidswirl_bench defines it and brings its own).
+//
+// Runs multiThread calls of various sizes, nested and from several threads at once, and the
+// mutex functions across threads. Prints every failed check and exits non-zero if any did.
+//
+//   ofxhost_threads_check
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "benchHost.h"
+#include "ofxMultiThread.h"
+
+namespace {
+
+    const OfxMultiThreadSuiteV1 *gSuite = NULL;
+    std::atomic<int> gFailures(0);
+
+    void check(bool ok, const char *what)
+    {
+        if (!ok) {
+            std::fprintf(stderr, "FAILED: %s\n", what);
+            ++gFailures;
+        }
+    }
+
+    // counts the calls of every slot of one multiThread call
+    struct SlotCounts {
+        unsigned int nThreads;
+        std::vector<std::atomic<int> > calls;
+
+        explicit SlotCounts(unsigned int n) : nThreads(n), calls(n) {}
+    };
+
+    void countSlot(unsigned int threadIndex, unsigned int threadMax, void *customArg)
+    {
+        SlotCounts &counts = *(SlotCounts *)customArg;
+        check(threadMax == counts.nThreads, "threadMax is the requested thread count");
+        check(threadIndex < counts.nThreads, "threadIndex is below threadMax");
+        if (threadIndex < counts.nThreads) {
+            ++counts.calls[threadIndex];
+        }
+
+        unsigned int index = ~0u;
+        check(gSuite->multiThreadIndex(&index) == kOfxStatOK && index == threadIndex,
+              "multiThreadIndex returns the slot being run");
+        check(gSuite->multiThreadIsSpawnedThread() != 0, "slots run as spawned threads");
+
+        SlotCounts nested(2);
+        check(gSuite->multiThread(countSlot, 2, &nested) == kOfxStatErrExists,
+              "a nested multiThread call is rejected with kOfxStatErrExists");
+    }
+
+    // runs one multiThread call of nThreads slots and checks every slot ran exactly once
+    void runSlots(unsigned int nThreads)
+    {
+        const unsigned int nSlots = nThreads > 0 ? nThreads : 1;
+        SlotCounts counts(nSlots);
+        check(gSuite->multiThread(countSlot, nThreads, &counts) == kOfxStatOK, "multiThread succeeds");
+        for (unsigned int i = 0; i < nSlots; ++i) {
+            check(counts.calls[i] == 1, "every slot runs exactly once");
+        }
+    }
+
+    void checkMultiThread()
+    {
+        unsigned int nCPUs = 0;
+        check(gSuite->multiThreadNumCPUs(&nCPUs) == kOfxStatOK && nCPUs > 0, "multiThreadNumCPUs reports a CPU");
+        check(gSuite->multiThreadIsSpawnedThread() == 0, "the main thread is not a spawned thread");
+
+        for (unsigned int n = 0; n <= 2 * nCPUs + 3; ++n) {
+            runSlots(n);
+        }
+
+        // several host threads sharing the pool at once
+        std::vector<std::thread> callers;
+        for (int c = 0; c < 4; ++c) {
+            callers.push_back(std::thread([nCPUs]() {
+                for (int k = 0; k < 200; ++k) {
+                    runSlots(1 + (k % (nCPUs + 4)));
+                }
+            }));
+        }
+        for (size_t c = 0; c < callers.size(); ++c) {
+            callers[c].join();
+        }
+
+        check(gSuite->multiThreadIsSpawnedThread() == 0, "the main thread is still not a spawned thread");
+    }
+
+    void checkMutex()
+    {
+        // created locked here, unlocked by another thread
+        OfxMutexHandle mutex = NULL;
+        check(gSuite->mutexCreate(&mutex, 1) == kOfxStatOK, "mutexCreate succeeds");
+        check(gSuite->mutexTryLock(mutex) == kOfxStatOK, "the creating thread holds a pre-locked mutex");
+        check(gSuite->mutexUnLock(mutex) == kOfxStatOK, "unlocking a recursive lock");
+        std::thread([mutex]() {
+            check(gSuite->mutexTryLock(mutex) == kOfxStatFailed, "a pre-locked mutex is held");
+            check(gSuite->mutexUnLock(mutex) == kOfxStatOK, "another thread may unlock a pre-locked mutex");
+            check(gSuite->mutexTryLock(mutex) == kOfxStatOK, "an unlocked mutex can be taken");
+            check(gSuite->mutexLock(mutex) == kOfxStatOK, "the holder may lock again");
+            check(gSuite->mutexUnLock(mutex) == kOfxStatOK && gSuite->mutexUnLock(mutex) == kOfxStatOK,
+                  "every lock is unlocked");
+        }).join();
+        check(gSuite->mutexUnLock(mutex) == kOfxStatFailed, "unlocking an unlocked mutex fails");
+
+        // lock waits for the holder
+        std::atomic<bool> released(false);
+        check(gSuite->mutexLock(mutex) == kOfxStatOK, "mutexLock succeeds");
+        std::thread waiter([mutex, &released]() {
+            check(gSuite->mutexLock(mutex) == kOfxStatOK, "mutexLock succeeds once released");
+            check(released, "mutexLock waits for the holder");
+            gSuite->mutexUnLock(mutex);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        released = true;
+        gSuite->mutexUnLock(mutex);
+        waiter.join();
+        check(gSuite->mutexDestroy(mutex) == kOfxStatOK, "mutexDestroy succeeds");
+    }
+
+}
+
+int main()
+{
+    BenchHost::Host host;
+    gSuite = (const OfxMultiThreadSuiteV1 *)host.fetchSuite(kOfxMultiThreadSuite, 1);
+    if (!gSuite) {
+        std::fprintf(stderr, "FAILED: the host has no %s\n", kOfxMultiThreadSuite);
+        return 1;
+    }
+
+    checkMultiThread();
+    checkMutex();
+
+    if (gFailures > 0) {
+        std::fprintf(stderr, "%d checks failed\n", gFailures.load());
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -116,20 +116,26 @@ int main(int argc, char **argv)
   // register the image effect cache with the global plugin cache
   imageEffectPluginCache.registerInCache(*OFX::Host::PluginCache::getPluginCache());
 
-  // try to read an old cache
-  std::ifstream ifs("hostDemoPluginCache.xml");
-  try {
-    OFX::Host::PluginCache::getPluginCache()->readCache(ifs);
-  } catch (const std::exception &e) {
-    std::cerr << "Error while reading XML cache: " << e.what() << std::endl;
+  // try to read an old cache, the binary one first as it is much quicker to load, then the XML one
+  bool binaryCacheRead = OFX::Host::PluginCache::getPluginCache()->readBinaryCache("hostDemoPluginCache.bin");
+  if (!binaryCacheRead) {
+    std::ifstream ifs("hostDemoPluginCache.xml");
+    try {
+      OFX::Host::PluginCache::getPluginCache()->readCache(ifs);
+    } catch (const std::exception &e) {
+      std::cerr << "Error while reading XML cache: " << e.what() << std::endl;
+    }
+    ifs.close();
   }
   OFX::Host::PluginCache::getPluginCache()->scanPluginFiles();
-  ifs.close();
 
-  /// flush out the current cache
-  std::ofstream of("hostDemoPluginCache.xml");
-  OFX::Host::PluginCache::getPluginCache()->writePluginCache(of);
-  of.close();
+  /// flush out the current cache, when it changed
+  if (!binaryCacheRead || OFX::Host::PluginCache::getPluginCache()->dirty()) {
+    OFX::Host::PluginCache::getPluginCache()->writeBinaryCache("hostDemoPluginCache.bin");
+    std::ofstream of("hostDemoPluginCache.xml");
+    OFX::Host::PluginCache::getPluginCache()->writePluginCache(of);
+    of.close();
+  }
 
   // get the invert example plugin which uses the OFX C++ support code
   OFX::Host::ImageEffect::ImageEffectPlugin* plugin = imageEffectPluginCache.getPluginById("net.sf.openfx:invertPlugin");
@@ -147,9 +147,11 @@ namespace MyHost {
   MyImage::MyImage(MyClipInstance &clip, OfxTime time, int view)
     : OFX::Host::ImageEffect::Image(clip) /// this ctor will set basic props on the image
     , _data(NULL)
+    , _dataCapacity(0)
   {
-    // make some memory
-    _data = new OfxRGBAColourB[kPalSizeXPixels * kPalSizeYPixels] ; /// PAL SD RGBA
+    // make some memory, from the host support pool so every fetch after the first reuses a
+    // block instead of allocating a new one
+    _data = (OfxRGBAColourB *)OFX::Host::Memory::allocate(kPalSizeXPixels * kPalSizeYPixels * sizeof(OfxRGBAColourB), _dataCapacity); /// PAL SD RGBA
     
     int fillValue = (int)(floor(255.0 * (time/OFXHOSTDEMOCLIPLENGTH))) & 0xff;
     OfxRGBAColourB color;
@@ -228,7 +230,7 @@ namespace MyHost {
 
   MyImage::~MyImage() 
   {
-    delete _data;
+    OFX::Host::Memory::release(_data, _dataCapacity);
   }
 
   MyClipInstance::MyClipInstance(MyEffectInstance* effect, OFX::Host::ImageEffect::ClipDescriptor *desc)
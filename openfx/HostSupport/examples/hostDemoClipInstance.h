@@ -42,6 +42,7 @@ namespace MyHost {
   {
   protected :
     OfxRGBAColourB   *_data; // where we are keeping our image data
+    size_t           _dataCapacity;
   public :
     explicit MyImage(MyClipInstance &clip, OfxTime t, int view = 0);
     OfxRGBAColourB* pixel(int x, int y) const;
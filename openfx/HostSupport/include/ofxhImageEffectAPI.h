@@ -220,6 +220,11 @@ namespace OFX {
         
         virtual void saveXML(Plugin *ip, std::ostream &os) const;
 
+        /// the descriptor properties, as saveXML() writes them, without going through XML
+        virtual void saveBinary(Plugin *ip, APICache::BinaryCacheWriter &writer) const;
+
+        virtual void loadBinary(Plugin *ip, APICache::BinaryCacheReader &reader);
+
         void confirmPlugin(Plugin *p, const std::list<std::string>& pluginPath);
 
         virtual bool pluginSupported(Plugin *p, std::string &reason) const;
@@ -31,6 +31,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef OFX_MEMORY_H
 #define OFX_MEMORY_H
 
+#include <stddef.h>
 #include <memory>
 
 namespace OFX {
@@ -45,6 +46,40 @@ namespace OFX {
 
     namespace Memory {
 
+      // Image memory is handed out from a process wide pool. Freed blocks are kept, up to a
+      // byte budget, and reused by later allocations of the same size class, so a host
+      // rendering frame after frame at the same image sizes stops paying for a system
+      // allocation and the page faults of fresh memory on every fetch. Sizes are rounded up
+      // to their class, at most a quarter more; the blocks of 2MB and up are mapped on 2MB
+      // boundaries and marked for transparent huge pages where the system has them. All the
+      // functions are thread safe.
+
+      /// pool counters, see getPoolStatistics()
+      struct PoolStatistics {
+        size_t allocations;   ///< blocks handed out by allocate()
+        size_t reuses;        ///< of those, the blocks taken from the pool instead of the system
+        size_t releases;      ///< blocks given back to the system
+        size_t bytesInUse;    ///< capacity of the blocks handed out and not released
+        size_t bytesCached;   ///< capacity of the freed blocks kept for reuse
+      };
+
+      /// sets the most bytes of freed blocks the pool keeps, 0 gives every block back to the
+      /// system on release. 512MB by default.
+      void setPoolBudget(size_t nBytes);
+      size_t getPoolBudget();
+
+      PoolStatistics getPoolStatistics();
+
+      /// gives all the cached blocks back to the system
+      void trimPool();
+
+      /// returns a block of at least nBytes, its actual size in capacity, throws std::bad_alloc
+      /// if there is no memory left
+      void *allocate(size_t nBytes, size_t &capacity);
+
+      /// gives a block from allocate() back to the pool, with the capacity it came with
+      void release(void *ptr, size_t capacity);
+
       class Instance {
       public:
         Instance();
@@ -60,7 +95,8 @@ namespace OFX {
         virtual bool verifyMagic() { return true; }
 
       protected:
-        char*   _ptr;
+        char*   _ptr;       // from Memory::allocate()
+        size_t  _capacity;
         int     _locked;
       };
 
@@ -57,6 +57,42 @@ namespace OFX
   {
     namespace APICache {
 
+      /// writes the values of the binary plugin cache, see PluginCache::writeBinaryCache(),
+      /// in the byte order of the machine
+      class BinaryCacheWriter
+      {
+        std::ostream &_os;
+      public:
+        explicit BinaryCacheWriter(std::ostream &os) : _os(os) {}
+
+        void writeInt(int v);
+        void writeInt64(long long v);
+        void writeDouble(double v);
+        /// length and bytes, also used for the blocks a reader can skip whole
+        void writeString(const std::string &s);
+      };
+
+      /// reads the values of a BinaryCacheWriter back in the same order, in place from the
+      /// mapped cache file. Reading past the end throws std::runtime_error.
+      class BinaryCacheReader
+      {
+        const char *_pos;
+        const char *_end;
+
+        void read(void *value, size_t nBytes);
+      public:
+        BinaryCacheReader(const char *begin, const char *end) : _pos(begin), _end(end) {}
+
+        bool atEnd() const { return _pos == _end; }
+
+        int readInt();
+        long long readInt64();
+        double readDouble();
+        std::string readString();
+        /// a block written with writeString(), as a reader of its own
+        BinaryCacheReader readBlock();
+      };
+
       /// this acts as an interface for the Plugin Cache, handling api-specific cacheing
       class PluginAPICacheI
       {
@@ -92,6 +128,14 @@ namespace OFX
         
         virtual void saveXML(Plugin *, std::ostream &) const = 0;
 
+        /// write the api specific data of a plugin to the binary cache. By default this is
+        /// what saveXML() writes, which loadBinary() feeds back through the XML handlers;
+        /// override both to skip the XML.
+        virtual void saveBinary(Plugin *, BinaryCacheWriter &) const;
+
+        /// read back what saveBinary() wrote
+        virtual void loadBinary(Plugin *, BinaryCacheReader &);
+
         virtual void confirmPlugin(Plugin *, const std::list<std::string>& pluginPath) = 0;
 
         virtual bool pluginSupported(Plugin *, std::string &reason) const = 0;
@@ -108,6 +152,12 @@ namespace OFX
       /// helper function to write a single property from a set to XML. Really should be a member of the property set!!!
       void propertyXMLWrite(std::ostream &o, const Property::Set &set, const std::string &name, int indent=0);
 
+      /// helper function to write a property set to the binary cache, pointers are left out like in the XML
+      void propertySetBinaryWrite(BinaryCacheWriter &writer, const Property::Set &set);
+
+      /// helper function to read a property set back from the binary cache
+      void propertySetBinaryRead(BinaryCacheReader &reader, Property::Set &set);
+
     }
   }
 }
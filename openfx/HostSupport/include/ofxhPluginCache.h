@@ -434,6 +434,9 @@ namespace OFX {
 
       void scanDirectory(std::set<std::string> &foundBinFiles, const std::string &dir, bool recurse);
 
+      /// add a binary read from a cache, NULL if it is a second statically linked one
+      PluginBinary *addCachedBinary(bool isStatic, const std::string &path, const std::string &bundlePath, time_t mtime, off_t size);
+
       bool _ignoreCache;
       std::string _cacheVersion;
 
@@ -508,6 +511,13 @@ namespace OFX {
       // populate the cache.  must call scanPluginFiles() after to check for changes.
       void readCache(std::istream &is);
 
+      /// populate the cache from a file written by writeBinaryCache(), which is mapped read
+      /// only and read in place. Returns false, having read nothing, if the file is missing,
+      /// damaged or from another cache version; readCache() on an XML cache is the fallback.
+      /// Like with readCache(), the binaries are checked against the mtime and size they had
+      /// when cached, and must call scanPluginFiles() after.
+      bool readBinaryCache(const std::string &filePath);
+
       // seek a particular file on the OFX plugin path
       std::string seekPluginFile(const std::string &baseName) const;
       
@@ -520,6 +530,11 @@ namespace OFX {
 
       // write the plugin cache output file to the given stream
       void writePluginCache(std::ostream &os) const;
+
+      /// write the cache in the binary format, to a temporary file next to filePath that then
+      /// replaces it, so other processes reading the cache never see half a file. Returns
+      /// false if it could not be written.
+      bool writeBinaryCache(const std::string &filePath) const;
       
       // callback function for the XML
       void elementBeginCallback(void *userData, const XML_Char *name, const XML_Char **attrs);
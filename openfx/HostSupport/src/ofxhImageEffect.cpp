@@ -70,6 +70,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <string.h>
 #include <stdarg.h>
+#if !defined(OFX_SUPPORTS_MULTITHREAD) && (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900))
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#endif
 
 namespace OFX {
 
@@ -4062,6 +4071,238 @@ namespace OFX {
         return gImageEffectHost->mutexTryLock(mutex);
       }
 #else // !OFX_SUPPORTS_MULTITHREAD
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+      /// a multithread suite running the threads on a pool of worker threads, which is created
+      /// on the first multiThread call and lives as long as the process
+
+      /// the slot of the multiThread call the current thread is running, if any
+      static thread_local unsigned int gThreadIndex = 0;
+      static thread_local bool gIsSpawnedThread = false;
+
+      static unsigned int getNumCPUs()
+      {
+        unsigned int nCPUs = std::thread::hardware_concurrency();
+        return nCPUs > 0 ? nCPUs : 1;
+      }
+
+      class ThreadPool {
+      public:
+        /// one multiThread call, its slots are handed out to whichever threads come first
+        struct Job {
+          OfxThreadFunctionV1 *func;
+          unsigned int nThreads;
+          void *customArg;
+          unsigned int nextIndex;  // next slot to hand out
+          unsigned int nDone;      // slots that have returned
+        };
+
+        explicit ThreadPool(unsigned int nWorkers)
+        {
+          _workers.reserve(nWorkers);
+          try {
+            for (unsigned int i = 0; i < nWorkers; ++i)
+              _workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+          }
+          catch (const std::system_error &) {
+            // out of threads, run with the workers we got, the calling thread does the rest
+          }
+        }
+
+        /// runs all the slots of job, on the calling thread and the workers, and returns when
+        /// they have all returned
+        void run(Job &job)
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _jobs.push_back(&job);
+          _wake.notify_all();
+          while (job.nextIndex < job.nThreads) {
+            unsigned int index = claim(job);
+            lock.unlock();
+            runSlot(job, index);
+            lock.lock();
+          }
+          // job is on our stack, so wait for the workers to be done with it
+          while (job.nDone < job.nThreads)
+            _finished.wait(lock);
+        }
+
+      private:
+        std::mutex _mutex;
+        std::condition_variable _wake;      // a job was queued
+        std::condition_variable _finished;  // the last slot of a job returned
+        std::deque<Job *> _jobs;            // jobs with slots left to hand out
+        std::vector<std::thread> _workers;
+
+        /// hands out the next slot of job, _mutex must be held
+        unsigned int claim(Job &job)
+        {
+          unsigned int index = job.nextIndex++;
+          if (job.nextIndex == job.nThreads)
+            _jobs.erase(std::find(_jobs.begin(), _jobs.end(), &job));
+          return index;
+        }
+
+        void runSlot(Job &job, unsigned int index)
+        {
+          unsigned int outerIndex = gThreadIndex;
+          bool outerIsSpawned = gIsSpawnedThread;
+          gThreadIndex = index;
+          gIsSpawnedThread = true;
+          job.func(index, job.nThreads, job.customArg);
+          gThreadIndex = outerIndex;
+          gIsSpawnedThread = outerIsSpawned;
+
+          // notify with the lock held, the job is gone as soon as run() sees it done
+          std::lock_guard<std::mutex> lock(_mutex);
+          if (++job.nDone == job.nThreads)
+            _finished.notify_all();
+        }
+
+        void workerLoop()
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          for (;;) {
+            while (_jobs.empty())
+              _wake.wait(lock);
+            Job &job = *_jobs.front();
+            unsigned int index = claim(job);
+            lock.unlock();
+            runSlot(job, index);
+            lock.lock();
+          }
+        }
+      };
+
+      static ThreadPool &getThreadPool()
+      {
+        // never deleted: the workers wait for jobs until the process exits, joining them from
+        // a static destructor could hang when the runtime has already stopped them
+        static ThreadPool *pool = new ThreadPool(getNumCPUs() - 1);
+        return *pool;
+      }
+
+      static OfxStatus multiThread(OfxThreadFunctionV1 func,
+                                   unsigned int nThreads,
+                                   void *customArg)
+      {
+        if (!func)
+          return kOfxStatFailed;
+        if (gIsSpawnedThread)
+          return kOfxStatErrExists;
+        if (nThreads == 0)
+          nThreads = 1;
+
+        ThreadPool::Job job = { func, nThreads, customArg, 0, 0 };
+        getThreadPool().run(job);
+        return kOfxStatOK;
+      }
+
+      static OfxStatus multiThreadNumCPUs(unsigned int *nCPUs)
+      {
+        if (!nCPUs)
+          return kOfxStatFailed;
+        *nCPUs = getNumCPUs();
+        return kOfxStatOK;
+      }
+
+      static OfxStatus multiThreadIndex(unsigned int *threadIndex){
+        if (!threadIndex)
+          return kOfxStatFailed;
+        *threadIndex = gThreadIndex;
+        return kOfxStatOK;
+      }
+
+      static int multiThreadIsSpawnedThread(void){
+        return gIsSpawnedThread;
+      }
+
+      /// an OFX mutex: recursive for the thread holding it, created locked lockCount times by
+      /// the creating thread, and, unlike std::recursive_mutex, free to be unlocked by any
+      /// thread, so a plugin may create it locked and hand it over
+      class Mutex {
+      public:
+        explicit Mutex(int lockCount)
+          : _owner(lockCount > 0 ? std::this_thread::get_id() : std::thread::id())
+          , _count(lockCount > 0 ? lockCount : 0)
+        {
+        }
+
+        void lock()
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          const std::thread::id self = std::this_thread::get_id();
+          while (_count > 0 && _owner != self)
+            _released.wait(lock);
+          _owner = self;
+          ++_count;
+        }
+
+        bool tryLock()
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          const std::thread::id self = std::this_thread::get_id();
+          if (_count > 0 && _owner != self)
+            return false;
+          _owner = self;
+          ++_count;
+          return true;
+        }
+
+        /// false if it was not locked
+        bool unlock()
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          if (_count == 0)
+            return false;
+          if (--_count == 0) {
+            _owner = std::thread::id();
+            _released.notify_one();
+          }
+          return true;
+        }
+
+      private:
+        std::mutex _mutex;
+        std::condition_variable _released;
+        std::thread::id _owner;
+        int _count;
+      };
+
+      static OfxStatus mutexCreate(OfxMutexHandle *mutex, int lockCount)
+      {
+        if (!mutex)
+          return kOfxStatFailed;
+        *mutex = reinterpret_cast<OfxMutexHandle>(new Mutex(lockCount));
+        return kOfxStatOK;
+      }
+
+      static OfxStatus mutexDestroy(const OfxMutexHandle mutex)
+      {
+        if (!mutex)
+          return kOfxStatErrBadHandle;
+        delete reinterpret_cast<Mutex *>(mutex);
+        return kOfxStatOK;
+      }
+
+      static OfxStatus mutexLock(const OfxMutexHandle mutex){
+        if (!mutex)
+          return kOfxStatErrBadHandle;
+        reinterpret_cast<Mutex *>(mutex)->lock();
+        return kOfxStatOK;
+      }
+       
+      static OfxStatus mutexUnLock(const OfxMutexHandle mutex){
+        if (!mutex)
+          return kOfxStatErrBadHandle;
+        return reinterpret_cast<Mutex *>(mutex)->unlock() ? kOfxStatOK : kOfxStatFailed;
+      }       
+
+      static OfxStatus mutexTryLock(const OfxMutexHandle mutex){
+        if (!mutex)
+          return kOfxStatErrBadHandle;
+        return reinterpret_cast<Mutex *>(mutex)->tryLock() ? kOfxStatOK : kOfxStatFailed;
+      }
+#else // no C++11 threads
       /// a simple multithread suite
       static OfxStatus multiThread(OfxThreadFunctionV1 func,
                                    unsigned int /*nThreads*/,
@@ -4129,6 +4370,7 @@ namespace OFX {
         // do nothing single threaded
         return kOfxStatOK;
       }
+#endif // no C++11 threads
 #endif // !OFX_SUPPORTS_MULTITHREAD
        
       static const struct OfxMultiThreadSuiteV1 gMultiThreadSuite = {
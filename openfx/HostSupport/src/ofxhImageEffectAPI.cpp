@@ -542,7 +542,19 @@ namespace OFX {
         }
       }
 
+      /// the contexts of a plugin read from the cache, as loadFromPlugin() adds them after describing
+      static void addCachedContexts(ImageEffectPlugin *p) {
+        const Property::Set &eProps = p->getDescriptor().getProps();
+        int size = eProps.getDimension(kOfxImageEffectPropSupportedContexts);
+        for (int j=0;j<size;j++) {
+          p->addContext(eProps.getStringProperty(kOfxImageEffectPropSupportedContexts, j));
+        }
+      }
+
       void PluginCache::endXmlParsing() {
+        if (_currentPlugin) {
+          addCachedContexts(_currentPlugin);
+        }
         _currentPlugin = 0;
       }
 
@@ -553,6 +565,23 @@ namespace OFX {
         }
       }
 
+      void PluginCache::saveBinary(Plugin *ip, APICache::BinaryCacheWriter &writer) const {
+        ImageEffectPlugin *p = dynamic_cast<ImageEffectPlugin*>(ip);
+        if (p) {
+          APICache::propertySetBinaryWrite(writer, p->getDescriptor().getProps());
+        } else {
+          writer.writeInt(0);
+        }
+      }
+
+      void PluginCache::loadBinary(Plugin *ip, APICache::BinaryCacheReader &reader) {
+        ImageEffectPlugin *p = dynamic_cast<ImageEffectPlugin*>(ip);
+        if (p) {
+          APICache::propertySetBinaryRead(reader, p->getDescriptor().getProps());
+          addCachedContexts(p);
+        }
+      }
+
       void PluginCache::confirmPlugin(Plugin *p, const std::list<std::string>& pluginPath) {
         ImageEffectPlugin *plugin = dynamic_cast<ImageEffectPlugin*>(p);
         if (!plugin) {
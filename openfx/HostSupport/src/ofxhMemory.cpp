@@ -36,23 +36,247 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // ofx host
 #include "ofxhMemory.h"
 
+#include <stdlib.h>
+#include <deque>
+#include <map>
+#include <new>
+#include <utility>
+#include <vector>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#include <mutex>
+#define OFXH_MEMORY_POOL_THREADS
+#endif
+
 namespace OFX {
 
   namespace Host {
 
     namespace Memory {
 
-      Instance::Instance() : _ptr(NULL), _locked(0) {}
+      static const size_t kPageBytes = 4096;
+      static const size_t kHugePageBytes = 2 * 1024 * 1024;
+      /// smaller blocks are left to malloc, which recycles them well enough
+      static const size_t kMinPooledBytes = 64 * 1024;
+
+      /// a freed block, serial orders them by age across the size classes
+      struct FreeBlock {
+        void *ptr;
+        unsigned long long serial;
+      };
+
+      // freed blocks by capacity, oldest first
+      typedef std::map<size_t, std::deque<FreeBlock> > FreeLists;
+
+      static FreeLists gFreeLists;
+      static size_t gPoolBudget = 512 * 1024 * 1024;
+      static PoolStatistics gPoolStatistics = { 0, 0, 0, 0, 0 };
+#ifdef OFXH_MEMORY_POOL_THREADS
+      static unsigned long long gNextSerial = 0;
+      static std::mutex gPoolMutex;
+#endif
+
+      /// holds the pool for the scope; without C++11 threads the pool keeps no blocks, so
+      /// only the counters go unguarded
+      class PoolLock {
+      public:
+#ifdef OFXH_MEMORY_POOL_THREADS
+        PoolLock() { gPoolMutex.lock(); }
+        ~PoolLock() { gPoolMutex.unlock(); }
+#else
+        PoolLock() {}
+        ~PoolLock() {}
+#endif
+      };
+
+      /// nBytes rounded up to its size class: quarters of the power of two below it, which are
+      /// whole pages, and whole huge pages from 8MB up; unrounded under kMinPooledBytes
+      static size_t getSizeClass(size_t nBytes)
+      {
+        if (nBytes < kMinPooledBytes)
+          return nBytes > 0 ? nBytes : 1;
+        if (nBytes > ~(size_t)0 / 4)
+          throw std::bad_alloc();
+        size_t step = kMinPooledBytes;
+        while (step * 2 <= nBytes)
+          step *= 2;
+        step /= 4;
+        return (nBytes + step - 1) / step * step;
+      }
+
+      static void *systemAllocate(size_t capacity)
+      {
+#if defined(__linux__)
+        if (capacity >= kHugePageBytes) {
+          // map a huge page more than asked and cut it back to a huge page boundary, so the
+          // kernel can back all of it with huge pages
+          size_t mappedBytes = capacity + kHugePageBytes;
+          char *mapped = (char *)mmap(NULL, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+          if (mapped == MAP_FAILED)
+            throw std::bad_alloc();
+          char *ptr = mapped + (kHugePageBytes - (size_t)mapped % kHugePageBytes) % kHugePageBytes;
+          if (ptr > mapped)
+            munmap(mapped, ptr - mapped);
+          if (ptr + capacity < mapped + mappedBytes)
+            munmap(ptr + capacity, mapped + mappedBytes - (ptr + capacity));
+#ifdef MADV_HUGEPAGE
+          madvise(ptr, capacity, MADV_HUGEPAGE);
+#endif
+          return ptr;
+        }
+#endif
+        void *ptr = malloc(capacity);
+        if (!ptr)
+          throw std::bad_alloc();
+        return ptr;
+      }
+
+      static void systemFree(void *ptr, size_t capacity)
+      {
+#if defined(__linux__)
+        if (capacity >= kHugePageBytes) {
+          munmap(ptr, capacity);
+          return;
+        }
+#endif
+        (void)capacity;
+        free(ptr);
+      }
+
+      /// unlinks the oldest cached blocks until the pool fits in budget, appending them to
+      /// evicted; the pool lock must be held
+      static void evictBlocks(size_t budget, std::vector<std::pair<void *, size_t> > &evicted)
+      {
+        while (gPoolStatistics.bytesCached > budget) {
+          FreeLists::iterator oldest = gFreeLists.end();
+          for (FreeLists::iterator it = gFreeLists.begin(); it != gFreeLists.end(); ++it) {
+            if (!it->second.empty() && (oldest == gFreeLists.end() || it->second.front().serial < oldest->second.front().serial))
+              oldest = it;
+          }
+          evicted.push_back(std::make_pair(oldest->second.front().ptr, oldest->first));
+          oldest->second.pop_front();
+          gPoolStatistics.bytesCached -= oldest->first;
+          ++gPoolStatistics.releases;
+        }
+      }
+
+      static void freeEvicted(const std::vector<std::pair<void *, size_t> > &evicted)
+      {
+        for (size_t i = 0; i < evicted.size(); ++i)
+          systemFree(evicted[i].first, evicted[i].second);
+      }
+
+      void setPoolBudget(size_t nBytes)
+      {
+        std::vector<std::pair<void *, size_t> > evicted;
+        {
+          PoolLock lock;
+          gPoolBudget = nBytes;
+          evictBlocks(nBytes, evicted);
+        }
+        freeEvicted(evicted);
+      }
+
+      size_t getPoolBudget()
+      {
+        PoolLock lock;
+        return gPoolBudget;
+      }
+
+      PoolStatistics getPoolStatistics()
+      {
+        PoolLock lock;
+        return gPoolStatistics;
+      }
+
+      void trimPool()
+      {
+        std::vector<std::pair<void *, size_t> > evicted;
+        {
+          PoolLock lock;
+          evictBlocks(0, evicted);
+        }
+        freeEvicted(evicted);
+      }
+
+      void *allocate(size_t nBytes, size_t &capacity)
+      {
+        capacity = getSizeClass(nBytes);
+#ifdef OFXH_MEMORY_POOL_THREADS
+        if (capacity >= kMinPooledBytes) {
+          PoolLock lock;
+          FreeLists::iterator it = gFreeLists.find(capacity);
+          if (it != gFreeLists.end() && !it->second.empty()) {
+            // the most recently freed block, the likeliest to still be in the caches
+            void *ptr = it->second.back().ptr;
+            it->second.pop_back();
+            gPoolStatistics.bytesCached -= capacity;
+            gPoolStatistics.bytesInUse += capacity;
+            ++gPoolStatistics.allocations;
+            ++gPoolStatistics.reuses;
+            return ptr;
+          }
+        }
+#endif
+
+        void *ptr;
+        try {
+          ptr = systemAllocate(capacity);
+        }
+        catch (std::bad_alloc &) {
+          // the cached blocks may be what is missing
+          trimPool();
+          ptr = systemAllocate(capacity);
+        }
+        PoolLock lock;
+        gPoolStatistics.bytesInUse += capacity;
+        ++gPoolStatistics.allocations;
+        return ptr;
+      }
+
+      void release(void *ptr, size_t capacity)
+      {
+        if (!ptr)
+          return;
+        std::vector<std::pair<void *, size_t> > evicted;
+        {
+          PoolLock lock;
+          gPoolStatistics.bytesInUse -= capacity;
+#ifdef OFXH_MEMORY_POOL_THREADS
+          if (capacity >= kMinPooledBytes && capacity <= gPoolBudget) {
+            try {
+              FreeBlock block = { ptr, gNextSerial++ };
+              gFreeLists[capacity].push_back(block);
+              gPoolStatistics.bytesCached += capacity;
+              ptr = NULL;
+              evictBlocks(gPoolBudget, evicted);
+            }
+            catch (std::bad_alloc &) {
+              // no room to keep it, free it below
+            }
+          }
+#endif
+          if (ptr)
+            ++gPoolStatistics.releases;
+        }
+        if (ptr)
+          systemFree(ptr, capacity);
+        freeEvicted(evicted);
+      }
+
+      Instance::Instance() : _ptr(NULL), _capacity(0), _locked(0) {}
 
       Instance::~Instance() {
-        delete [] _ptr;
+        release(_ptr, _capacity);
       }
 
       bool Instance::alloc(size_t nBytes) {
         if(!_locked){
           if(_ptr)
             freeMem(); // ignore return value
-          _ptr = new char[nBytes];
+          _ptr = (char *)allocate(nBytes, _capacity);
           return true;
         }
         else
@@ -64,8 +288,9 @@ namespace OFX {
       }
 
       bool Instance::freeMem(){
-        delete [] _ptr;
+        release(_ptr, _capacity);
         _ptr = 0;
+        _capacity = 0;
         _locked = 0;
         return true;
       }
@@ -28,9 +28,14 @@
 */
 
 #include <assert.h>
+#include <string.h>
 
 #include <string>
 #include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "expat.h"
 
 // ofx
 #include "ofxCore.h"
@@ -55,10 +60,112 @@ namespace OFX
   {
     namespace APICache
     {
+      void BinaryCacheWriter::writeInt(int v) {
+        _os.write((const char *)&v, sizeof(v));
+      }
+
+      void BinaryCacheWriter::writeInt64(long long v) {
+        _os.write((const char *)&v, sizeof(v));
+      }
+
+      void BinaryCacheWriter::writeDouble(double v) {
+        _os.write((const char *)&v, sizeof(v));
+      }
+
+      void BinaryCacheWriter::writeString(const std::string &s) {
+        writeInt((int)s.size());
+        _os.write(s.data(), s.size());
+      }
+
+      void BinaryCacheReader::read(void *value, size_t nBytes) {
+        if ((size_t)(_end - _pos) < nBytes) {
+          throw std::runtime_error("truncated binary plugin cache");
+        }
+        memcpy(value, _pos, nBytes);
+        _pos += nBytes;
+      }
+
+      int BinaryCacheReader::readInt() {
+        int v;
+        read(&v, sizeof(v));
+        return v;
+      }
+
+      long long BinaryCacheReader::readInt64() {
+        long long v;
+        read(&v, sizeof(v));
+        return v;
+      }
+
+      double BinaryCacheReader::readDouble() {
+        double v;
+        read(&v, sizeof(v));
+        return v;
+      }
+
+      std::string BinaryCacheReader::readString() {
+        BinaryCacheReader block = readBlock();
+        return std::string(block._pos, block._end);
+      }
+
+      BinaryCacheReader BinaryCacheReader::readBlock() {
+        int nBytes = readInt();
+        if (nBytes < 0 || _end - _pos < nBytes) {
+          throw std::runtime_error("truncated binary plugin cache");
+        }
+        BinaryCacheReader block(_pos, _pos + nBytes);
+        _pos += nBytes;
+        return block;
+      }
+
       void PluginAPICacheI::registerInCache(OFX::Host::PluginCache &pluginCache) {
         pluginCache.registerAPICache(_apiName, _apiVersionMin, _apiVersionMax, this);
       }      
 
+      void PluginAPICacheI::saveBinary(Plugin *plugin, BinaryCacheWriter &writer) const {
+        std::ostringstream os;
+        os << "<apiproperties>\n";
+        saveXML(plugin, os);
+        os << "</apiproperties>\n";
+        writer.writeString(os.str());
+      }
+
+      /// callbacks for the XML of the default loadBinary(), the user data is the handler
+      static void apiElementBeginHandler(void *userData, const XML_Char *name, const XML_Char **atts) {
+        std::map<std::string, std::string> attmap;
+        while (*atts) {
+          attmap[atts[0]] = atts[1];
+          atts += 2;
+        }
+        ((PluginAPICacheI *)userData)->xmlElementBegin(name, attmap);
+      }
+
+      static void apiElementCharHandler(void *userData, const XML_Char *data, int len) {
+        ((PluginAPICacheI *)userData)->xmlCharacterHandler(std::string(data, len));
+      }
+
+      static void apiElementEndHandler(void *userData, const XML_Char *name) {
+        ((PluginAPICacheI *)userData)->xmlElementEnd(name);
+      }
+
+      void PluginAPICacheI::loadBinary(Plugin *plugin, BinaryCacheReader &reader) {
+        std::string xml = reader.readString();
+        XML_Parser xP = XML_ParserCreate(NULL);
+        if (!xP) {
+          throw std::runtime_error("Error creating XML parser");
+        }
+        XML_SetUserData(xP, this);
+        XML_SetElementHandler(xP, apiElementBeginHandler, apiElementEndHandler);
+        XML_SetCharacterDataHandler(xP, apiElementCharHandler);
+        beginXmlParsing(plugin);
+        bool parsed = XML_Parse(xP, xml.data(), (int)xml.size(), true) != XML_STATUS_ERROR;
+        endXmlParsing();
+        XML_ParserFree(xP);
+        if (!parsed) {
+          throw std::runtime_error("XML parsing error in binary plugin cache");
+        }
+      }
+
       void propertySetXMLRead(const std::string &el,
                               std::map<std::string, std::string> map,
                               Property::Set &set,
@@ -144,6 +251,94 @@ namespace OFX
         }
       }
 
+      void propertySetBinaryWrite(BinaryCacheWriter &writer, const Property::Set &set)
+      {
+        int nProps = 0;
+        for (Property::PropertyMap::const_iterator i = set.getProperties().begin();
+             i != set.getProperties().end();
+             i++) {
+          if (i->second->getType() != Property::ePointer) {
+            nProps++;
+          }
+        }
+        writer.writeInt(nProps);
+
+        for (Property::PropertyMap::const_iterator i = set.getProperties().begin();
+             i != set.getProperties().end();
+             i++) {
+          Property::Property *prop = i->second;
+          int dimension = prop->getDimension();
+          switch (prop->getType()) {
+          case Property::eInt:
+          case Property::eDouble:
+          case Property::eString:
+            writer.writeString(prop->getName());
+            writer.writeInt(prop->getType());
+            writer.writeInt(prop->getFixedDimension());
+            writer.writeInt(dimension);
+            break;
+          default:
+            continue;
+          }
+          for (int j = 0; j < dimension; j++) {
+            if (prop->getType() == Property::eInt) {
+              writer.writeInt(static_cast<Property::Int *>(prop)->getValues()[j]);
+            } else if (prop->getType() == Property::eDouble) {
+              writer.writeDouble(static_cast<Property::Double *>(prop)->getValues()[j]);
+            } else {
+              writer.writeString(static_cast<Property::String *>(prop)->getValues()[j]);
+            }
+          }
+        }
+      }
+
+      void propertySetBinaryRead(BinaryCacheReader &reader, Property::Set &set)
+      {
+        int nProps = reader.readInt();
+        for (int i = 0; i < nProps; i++) {
+          std::string propName = reader.readString();
+          int propType = reader.readInt();
+          int fixedDimension = reader.readInt();
+          int dimension = reader.readInt();
+          if (propType != Property::eInt && propType != Property::eDouble && propType != Property::eString) {
+            throw std::runtime_error("bad property type in binary plugin cache");
+          }
+
+          Property::Property *prop = set.fetchProperty(propName, false);
+          if (!prop) {
+            if (propType == Property::eInt) {
+              prop = new Property::Int(propName, fixedDimension, false, 0);
+            } else if (propType == Property::eDouble) {
+              prop = new Property::Double(propName, fixedDimension, false, 0);
+            } else {
+              prop = new Property::String(propName, fixedDimension, false, "");
+            }
+            set.addProperty(prop);
+          }
+
+          // values of a property that changed type are read and dropped
+          bool sameType = prop->getType() == propType;
+          for (int j = 0; j < dimension; j++) {
+            if (propType == Property::eInt) {
+              int value = reader.readInt();
+              if (sameType) {
+                set.setIntProperty(propName, value, j);
+              }
+            } else if (propType == Property::eDouble) {
+              double value = reader.readDouble();
+              if (sameType) {
+                set.setDoubleProperty(propName, value, j);
+              }
+            } else {
+              std::string value = reader.readString();
+              if (sameType) {
+                set.setStringProperty(propName, value, j);
+              }
+            }
+          }
+        }
+      }
+
       void propertySetXMLWrite(std::ostream &o, const Property::Set &set, int indent) 
       {
         std::string indent_prefix(indent, ' ');
@@ -102,6 +102,14 @@ static const char *getArchStr()
 #define DIRSEP "\\"
 
 #include "shlobj.h"
+#include <process.h> // _getpid
+#endif
+
+#if !defined (WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 
@@ -564,6 +572,31 @@ void PluginCache::scanPluginFiles()
 }
 
 
+PluginBinary *PluginCache::addCachedBinary(bool isStatic, const std::string &path, const std::string &bundlePath, time_t mtime, off_t size)
+{
+  PluginBinary* pb;
+#ifdef OFX_USE_STATIC_PLUGINS
+  if (isStatic) {
+    // only 1 static binary allowed!
+    if (_staticBinary) {
+      return 0;
+    }
+    // We need to provide the 2 function pointers for the static binary
+    std::string cachedPath = path;
+    pb = new PluginBinary(_hostAppBinFilePath, &OfxGetNumberOfPlugins,&OfxGetPlugin, this, &cachedPath, &mtime, &size);
+    _staticBinary = pb;
+  } else
+#else
+  (void)isStatic;
+#endif
+  {
+    pb = new PluginBinary(path, bundlePath, mtime, size);
+  }
+  _binaries.push_back(pb);
+  _knownBinFiles.insert(path);
+  return pb;
+}
+
 /// callback for XML parser
 static void elementBeginHandler(void *userData, const XML_Char *name, const XML_Char **atts) {
   PluginCache::getPluginCache()->elementBeginCallback(userData, name, atts);
@@ -632,25 +665,14 @@ void PluginCache::elementBeginCallback(void */*userData*/, const XML_Char *name,
     time_t mtime = OFX::Host::Property::stringToInt(attmap["mtime"]);
     off_t size = OFX::Host::Property::stringToInt(attmap["size"]);
 
-    PluginBinary* pb;
 #ifdef OFX_USE_STATIC_PLUGINS
-    if (isStaticLinkedCachedBinary) {
-      // only 1 static binary allowed!
-      if (_staticBinary) {
-        _ignoreCache = true;
-        return;
-      }
-      // We need to provide the 2 function pointers for the static binary
-      pb = new PluginBinary(_hostAppBinFilePath, &OfxGetNumberOfPlugins,&OfxGetPlugin, this, &fname, &mtime, &size);
-      _staticBinary = pb;
-    } else
+    _xmlCurrentBinary = addCachedBinary(isStaticLinkedCachedBinary, fname, bname, mtime, size);
+#else
+    _xmlCurrentBinary = addCachedBinary(false, fname, bname, mtime, size);
 #endif
-    {
-      pb = new PluginBinary(fname, bname, mtime, size);
+    if (!_xmlCurrentBinary) {
+      _ignoreCache = true;
     }
-    _xmlCurrentBinary = pb;
-    _binaries.push_back(_xmlCurrentBinary);
-    _knownBinFiles.insert(fname);
     
     return;
   }
@@ -822,6 +844,224 @@ void PluginCache::writePluginCache(std::ostream &os) const {
 }
 
 
+/// first bytes of a binary cache, then the format version and a marker for the byte order
+static const char kBinaryCacheMagic[8] = {'O', 'F', 'X', 'H', 'B', 'C', 'A', 'C'};
+static const int kBinaryCacheFormat = 1;
+static const int kBinaryCacheByteOrder = 0x01020304;
+
+/// a file mapped read only, for as long as this lives
+class MappedCacheFile {
+  const char *_data;
+  size_t _size;
+#if defined (WINDOWS)
+  HANDLE _mapping;
+#endif
+
+  MappedCacheFile(const MappedCacheFile &);             ///< hidden
+  MappedCacheFile &operator= (const MappedCacheFile &); ///< hidden
+
+public:
+  explicit MappedCacheFile(const std::string &filePath) : _data(0), _size(0) {
+#if defined (WINDOWS)
+    _mapping = NULL;
+    HANDLE file = CreateFileW(OFX::utf8_to_utf16(filePath).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+      _mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (_mapping) {
+        _data = (const char *)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+        _size = _data ? (size_t)size.QuadPart : 0;
+      }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+      void *data = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        _data = (const char *)data;
+        _size = (size_t)sb.st_size;
+      }
+    }
+    close(fd);
+#endif
+  }
+
+  ~MappedCacheFile() {
+#if defined (WINDOWS)
+    if (_data) {
+      UnmapViewOfFile(_data);
+    }
+    if (_mapping) {
+      CloseHandle(_mapping);
+    }
+#else
+    if (_data) {
+      munmap((void *)_data, _size);
+    }
+#endif
+  }
+
+  const char *data() const { return _data; }
+  size_t size() const { return _size; }
+};
+
+bool PluginCache::readBinaryCache(const std::string &filePath) {
+  MappedCacheFile file(filePath);
+  if (!file.data() || file.size() < sizeof(kBinaryCacheMagic) || memcmp(file.data(), kBinaryCacheMagic, sizeof(kBinaryCacheMagic)) != 0) {
+    return false;
+  }
+
+  // what this read adds, taken back out if the file turns out to be damaged
+  std::list<PluginBinary *>::iterator lastBinary = _binaries.end();
+  if (!_binaries.empty()) {
+    --lastBinary;
+  }
+  std::set<std::string> knownBinFiles = _knownBinFiles;
+
+  try {
+    APICache::BinaryCacheReader reader(file.data() + sizeof(kBinaryCacheMagic), file.data() + file.size());
+    if (reader.readInt() != kBinaryCacheFormat || reader.readInt() != kBinaryCacheByteOrder ||
+        reader.readInt64() != (long long)file.size()) {
+      return false;
+    }
+    std::string cacheVersion = reader.readString();
+    if (cacheVersion != _cacheVersion) {
+#ifdef CACHE_DEBUG
+      printf("mismatched version, ignoring cache (got '%s', wanted '%s')\n",
+             cacheVersion.c_str(),
+             _cacheVersion.c_str());
+#endif
+      return false;
+    }
+
+    int nBinaries = reader.readInt();
+    for (int i = 0; i < nBinaries; i++) {
+      bool isStatic = reader.readInt() != 0;
+      std::string fname = reader.readString();
+      std::string bname = reader.readString();
+      time_t mtime = (time_t)reader.readInt64();
+      off_t size = (off_t)reader.readInt64();
+      int nPlugins = reader.readInt();
+
+      PluginBinary *pb = addCachedBinary(isStatic, fname, bname, mtime, size);
+      if (!pb) {
+        throw std::runtime_error("second static binary in binary plugin cache");
+      }
+
+      for (int j = 0; j < nPlugins; j++) {
+        std::string api = reader.readString();
+        int apiVersion = reader.readInt();
+        std::string rawIdentifier = reader.readString();
+        int index = reader.readInt();
+        int majorVersion = reader.readInt();
+        int minorVersion = reader.readInt();
+        APICache::BinaryCacheReader apiData = reader.readBlock();
+
+        // a changed binary is loaded again by scanPluginFiles()
+        APICache::PluginAPICacheI *apiCache = findApiHandler(api, apiVersion);
+        if (apiCache && !pb->hasBinaryChanged()) {
+          Plugin *pe = apiCache->newPlugin(pb, index, api, apiVersion, rawIdentifier, rawIdentifier, majorVersion, minorVersion);
+          pb->addPlugin(pe);
+          apiCache->loadBinary(pe, apiData);
+        }
+      }
+    }
+    if (!reader.atEnd()) {
+      throw std::runtime_error("trailing bytes in binary plugin cache");
+    }
+  } catch (...) {
+    std::list<PluginBinary *>::iterator first = lastBinary == _binaries.end() ? _binaries.begin() : ++lastBinary;
+    for (std::list<PluginBinary *>::iterator i = first; i != _binaries.end(); ++i) {
+#ifdef OFX_USE_STATIC_PLUGINS
+      if (*i == _staticBinary) {
+        _staticBinary = 0;
+      }
+#endif
+      delete *i;
+    }
+    _binaries.erase(first, _binaries.end());
+    _knownBinFiles.swap(knownBinFiles);
+    return false;
+  }
+  return true;
+}
+
+bool PluginCache::writeBinaryCache(const std::string &filePath) const {
+  std::ostringstream os;
+  APICache::BinaryCacheWriter writer(os);
+  os.write(kBinaryCacheMagic, sizeof(kBinaryCacheMagic));
+  writer.writeInt(kBinaryCacheFormat);
+  writer.writeInt(kBinaryCacheByteOrder);
+  std::streampos sizePos = os.tellp();
+  writer.writeInt64(0); // file size, filled in below
+  writer.writeString(_cacheVersion);
+
+  writer.writeInt((int)_binaries.size());
+  for (std::list<PluginBinary *>::const_iterator i=_binaries.begin();i!=_binaries.end();i++) {
+    PluginBinary *b = *i;
+    writer.writeInt(b->isStaticallyLinkedPlugin());
+    writer.writeString(b->getFilePath());
+    writer.writeString(b->getBundlePath());
+    writer.writeInt64(b->getFileModificationTime());
+    writer.writeInt64(b->getFileSize());
+    writer.writeInt(b->getNPlugins());
+
+    for (int j=0;j<b->getNPlugins();j++) {
+      Plugin *p = &b->getPlugin(j);
+      writer.writeString(p->getPluginApi());
+      writer.writeInt(p->getApiVersion());
+      writer.writeString(p->getRawIdentifier());
+      writer.writeInt(p->getIndex());
+      writer.writeInt(p->getVersionMajor());
+      writer.writeInt(p->getVersionMinor());
+
+      std::ostringstream apiOs;
+      APICache::BinaryCacheWriter apiWriter(apiOs);
+      p->getApiHandler().saveBinary(p, apiWriter);
+      writer.writeString(apiOs.str());
+    }
+  }
+
+  std::string data = os.str();
+  long long size = (long long)data.size();
+  memcpy(&data[(size_t)sizePos], &size, sizeof(size));
+
+  // one temporary file per process, several of them may be rewriting the cache at once
+  std::ostringstream tmpPath;
+#if defined (WINDOWS)
+  tmpPath << filePath << "." << _getpid() << ".tmp";
+#else
+  tmpPath << filePath << "." << getpid() << ".tmp";
+#endif
+  {
+    std::ofstream ofs(tmpPath.str().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    ofs.write(data.data(), data.size());
+    ofs.close();
+    if (!ofs) {
+      remove(tmpPath.str().c_str());
+      return false;
+    }
+  }
+#if defined (WINDOWS)
+  bool renamed = MoveFileExW(OFX::utf8_to_utf16(tmpPath.str()).c_str(), OFX::utf8_to_utf16(filePath).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  bool renamed = rename(tmpPath.str().c_str(), filePath.c_str()) == 0;
+#endif
+  if (!renamed) {
+    remove(tmpPath.str().c_str());
+  }
+  return renamed;
+}
+
 APICache::PluginAPICacheI *PluginCache::findApiHandler(const std::string &api, int version) {
   std::list<PluginCacheSupportedApi>::iterator i = _apiHandlers.begin();
   while (i != _apiHandlers.end()) {
@@ -46,6 +46,7 @@ of the direct OFX objects and any library side only functions.
 #include <string>
 #include <sstream> // stringstream
 #include <memory>
+#include <cstddef> // ptrdiff_t
 #ifndef NDEBUG
 #include <stdio.h> // printf in debug
 #endif
@@ -932,6 +933,63 @@ namespace OFX {
 #endif
   };
 
+  ////////////////////////////////////////////////////////////////////////////////
+  /** @brief Unchecked access to the pixel data of an image, for per pixel loops
+
+  A plain, trivially copyable copy of an image's base address, bounds, row bytes and pixel
+  stride, taken with Image::getImageView. Unlike Image::getPixelAddress, the accessors are
+  inline and check nothing: coordinates outside the bounds give addresses outside the
+  data, and custom components (zero pixel bytes) are not caught. Test coordinates against
+  getBounds() once per row or tile and address pixels through the view inside.
+
+  Byte is char for ImageView and const char for ConstImageView; an ImageView converts to a
+  ConstImageView.
+  */
+  template <class Byte>
+  class ImageViewT {
+    Byte     *_pixelData;                    /**< @brief the address of the pixel at (_bounds.x1, _bounds.y1) */
+    OfxRectI  _bounds;                       /**< @brief the bounds on the pixel data */
+    ptrdiff_t _rowBytes;                     /**< @brief the number of bytes per scanline, may be negative */
+    int       _pixelBytes;                   /**< @brief the number of bytes per pixel */
+
+  public :
+    /** @brief an empty view */
+    ImageViewT() : _pixelData(0), _rowBytes(0), _pixelBytes(0) { _bounds.x1 = _bounds.y1 = _bounds.x2 = _bounds.y2 = 0; }
+
+    /** @brief a view of the pixels in bounds, the first one at pixelData */
+    ImageViewT(Byte *pixelData, const OfxRectI &bounds, ptrdiff_t rowBytes, int pixelBytes)
+      : _pixelData(pixelData), _bounds(bounds), _rowBytes(rowBytes), _pixelBytes(pixelBytes) {}
+
+    /** @brief the same pixels through another byte type, from ImageView to ConstImageView */
+    template <class OtherByte>
+    ImageViewT(const ImageViewT<OtherByte> &other)
+      : _pixelData(other.getPixelData()), _bounds(other.getBounds()), _rowBytes(other.getRowBytes()), _pixelBytes(other.getPixelBytes()) {}
+
+    /** @brief the address of the first pixel */
+    Byte *getPixelData(void) const { return _pixelData;}
+
+    /** @brief the bounds on the pixel data (in pixel coordinates) */
+    const OfxRectI& getBounds(void) const { return _bounds;}
+
+    /** @brief the row bytes, may be negative */
+    ptrdiff_t getRowBytes(void) const { return _rowBytes;}
+
+    /** @brief the number of bytes per pixel */
+    int getPixelBytes(void) const { return _pixelBytes;}
+
+    /** @brief whether (x, y) lies inside the bounds */
+    bool contains(int x, int y) const { return x >= _bounds.x1 && x < _bounds.x2 && y >= _bounds.y1 && y < _bounds.y2;}
+
+    /** @brief the address of the first pixel of row y, unchecked */
+    Byte *getRowAddress(int y) const { return _pixelData + (ptrdiff_t)(y - _bounds.y1) * _rowBytes;}
+
+    /** @brief the address of pixel (x, y), unchecked */
+    Byte *getPixelAddress(int x, int y) const { return getRowAddress(y) + (ptrdiff_t)(x - _bounds.x1) * _pixelBytes;}
+  };
+
+  typedef ImageViewT<char> ImageView;
+  typedef ImageViewT<const char> ConstImageView;
+
   ////////////////////////////////////////////////////////////////////////////////
   /** @brief Wraps up an image */
   class ImageBase {
@@ -1056,6 +1114,12 @@ namespace OFX {
     /** @brief get the pixel data for this image */
     const void *getPixelData(void) const { return _pixelData;}
 
+    /** @brief unchecked view of the pixel data for hot loops, see ImageViewT */
+    ImageView getImageView(void) { return ImageView((char *) _pixelData, _bounds, _rowBytes, _pixelBytes);}
+
+    /** @brief unchecked read only view of the pixel data for hot loops, see ImageViewT */
+    ConstImageView getImageView(void) const { return ConstImageView((const char *) _pixelData, _bounds, _rowBytes, _pixelBytes);}
+
     /** @brief return a pixel pointer, returns NULL if (x,y) is outside the image bounds
 
     x and y are in pixel coordinates
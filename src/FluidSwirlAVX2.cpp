@@ -0,0 +1,267 @@
+// AVX2 + FMA kernels, 8 pixels per iteration. Built with -mavx2 -mfma (/arch:AVX2 on MSVC),
+// called only after the dispatch in FluidSwirlSIMD.cpp has checked the CPU.
+
+#include <immintrin.h>
+
+#include "FluidSwirlSIMDKernels.hpp"
+
+namespace {
+
+    // The operations radialSwirlTableRow needs
+    struct AVX2 {
+        typedef __m256 F;
+        typedef __m256i I;
+        static const int kWidth = 8;
+
+        static F set1(float v) { return _mm256_set1_ps(v); }
+        static F ramp(float v) { return _mm256_add_ps(_mm256_set1_ps(v), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)); }
+        static void store(float *p, F v) { _mm256_store_ps(p, v); }
+
+        static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+        static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+        static F min(F a, F b) { return _mm256_min_ps(a, b); }
+        static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+        static F fmadd(F a, F b, F c) { return _mm256_fmadd_ps(a, b, c); }
+        static F fmsub(F a, F b, F c) { return _mm256_fmsub_ps(a, b, c); }
+
+        static F gather(const float *base, I index) { return _mm256_i32gather_ps(base, index, 4); }
+
+        static I truncate(F a) { return _mm256_cvttps_epi32(a); }
+        static F toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+        static I shiftLeft2(I a) { return _mm256_slli_epi32(a, 2); }
+    };
+
+    using FluidSwirlSIMD::BilinearSource;
+
+    // Top left taps and weights of 8 consecutive pixels, the taps relative to (src.x1, src.y1).
+    // The same steps as the clamped scalar resampler, so the weights match it bit for bit.
+    struct BilinearTaps {
+        __m256i x, y;
+        __m256 fx, fy;
+        int edgeMask;   // bit k: pixel k had taps outside the source before the clamp
+    };
+
+    inline BilinearTaps getBilinearTaps(const BilinearSource &src, int x, int y, const float *offsets)
+    {
+        // (dx, dy) pairs to 8 dx and 8 dy
+        const __m256 a = _mm256_loadu_ps(offsets);
+        const __m256 b = _mm256_loadu_ps(offsets + 8);
+        const __m256 dx = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+        const __m256 dy = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        const __m256i column = _mm256_add_epi32(_mm256_set1_epi32(x), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        const __m256 srcX = _mm256_add_ps(_mm256_cvtepi32_ps(column), dx);
+        const __m256 srcY = _mm256_add_ps(_mm256_set1_ps((float)y), dy);
+
+        // out of range and NaN positions convert to INT_MIN, which counts as outside too
+        const __m256i lastX = _mm256_set1_epi32(src.x2 - 2);
+        const __m256i lastY = _mm256_set1_epi32(src.y2 - 2);
+        const __m256i rawX = _mm256_cvttps_epi32(_mm256_floor_ps(srcX));
+        const __m256i rawY = _mm256_cvttps_epi32(_mm256_floor_ps(srcY));
+        const __m256i outside = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(src.x1), rawX), _mm256_cmpgt_epi32(rawX, lastX)),
+            _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(src.y1), rawY), _mm256_cmpgt_epi32(rawY, lastY)));
+
+        const __m256 clampedX = _mm256_max_ps(_mm256_min_ps(srcX, _mm256_set1_ps((float)(src.x2 - 1))), _mm256_set1_ps((float)src.x1));
+        const __m256 clampedY = _mm256_max_ps(_mm256_min_ps(srcY, _mm256_set1_ps((float)(src.y2 - 1))), _mm256_set1_ps((float)src.y1));
+        const __m256i tapX = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(clampedX)), lastX);
+        const __m256i tapY = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(clampedY)), lastY);
+
+        BilinearTaps taps;
+        taps.x = _mm256_sub_epi32(tapX, _mm256_set1_epi32(src.x1));
+        taps.y = _mm256_sub_epi32(tapY, _mm256_set1_epi32(src.y1));
+        taps.fx = _mm256_sub_ps(clampedX, _mm256_cvtepi32_ps(tapX));
+        taps.fy = _mm256_sub_ps(clampedY, _mm256_cvtepi32_ps(tapY));
+        taps.edgeMask = _mm256_movemask_ps(_mm256_castsi256_ps(outside));
+        return taps;
+    }
+
+    // 8-bit RGBA: both horizontal neighbours of a row in one 64-bit load, two pixels per
+    // register, and the fixed point weights of the scalar taps (8 fractional bits, rounded)
+    struct UByte4 {
+        static const int kPixelBytes = 4;
+
+        static void resample(const BilinearSource &src, const BilinearTaps &taps, char *dst)
+        {
+            const __m256i one = _mm256_set1_epi32(256);
+            const __m256 half = _mm256_set1_ps(0.5f);
+            const __m256i wx = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(taps.fx, _mm256_set1_ps(256.0f)), half));
+            const __m256i wy = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(taps.fy, _mm256_set1_ps(256.0f)), half));
+
+            // (256 - wx, wx) as the 16-bit weight pair of each pixel
+            alignas(32) int xs[8], ys[8], wxPairs[8], wys[8];
+            _mm256_store_si256((__m256i *)xs, taps.x);
+            _mm256_store_si256((__m256i *)ys, taps.y);
+            _mm256_store_si256((__m256i *)wxPairs, _mm256_or_si256(_mm256_slli_epi32(wx, 16), _mm256_sub_epi32(one, wx)));
+            _mm256_store_si256((__m256i *)wys, wy);
+
+            // p00 p10 p01 p11 to (p00, p10) and (p01, p11) component pairs
+            const __m256i interleave = _mm256_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15,
+                                                        0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+            const char *origin = (const char *)src.origin;
+            for (int k = 0; k < 8; k += 2) {
+                const char *a = origin + ys[k] * src.rowBytes + xs[k] * 4;
+                const char *b = origin + ys[k + 1] * src.rowBytes + xs[k + 1] * 4;
+                const __m128i tapsA = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)a), _mm_loadl_epi64((const __m128i *)(a + src.rowBytes)));
+                const __m128i tapsB = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)b), _mm_loadl_epi64((const __m128i *)(b + src.rowBytes)));
+                const __m256i pairs = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(tapsA), tapsB, 1), interleave);
+
+                // rows in 32 bits, at most 255 * 256 each
+                const __m256i weightX = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi32(wxPairs[k])), _mm_set1_epi32(wxPairs[k + 1]), 1);
+                const __m256i top = _mm256_madd_epi16(_mm256_unpacklo_epi8(pairs, _mm256_setzero_si256()), weightX);
+                const __m256i bottom = _mm256_madd_epi16(_mm256_unpackhi_epi8(pairs, _mm256_setzero_si256()), weightX);
+
+                const __m256i weightY = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi32(wys[k])), _mm_set1_epi32(wys[k + 1]), 1);
+                __m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(top, _mm256_sub_epi32(one, weightY)), _mm256_mullo_epi32(bottom, weightY));
+                sum = _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(1 << 15)), 16);
+
+                const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+                _mm_storel_epi64((__m128i *)(dst + 4 * k), _mm_packus_epi16(words, words));
+            }
+        }
+    };
+
+    // The weights of the float taps, in the order the scalar taps apply them
+    struct FloatWeights {
+        __m256 fx, fy, fx1, fy1;
+
+        explicit FloatWeights(const BilinearTaps &taps)
+            : fx(taps.fx), fy(taps.fy), fx1(_mm256_sub_ps(_mm256_set1_ps(1.0f), taps.fx)), fy1(_mm256_sub_ps(_mm256_set1_ps(1.0f), taps.fy)) {}
+    };
+
+    // Float RGBA: both horizontal neighbours of a row in one 256-bit load
+    struct Float4 {
+        static const int kPixelBytes = 16;
+
+        static void resample(const BilinearSource &src, const BilinearTaps &taps, char *dst)
+        {
+            const FloatWeights w(taps);
+            alignas(32) int xs[8], ys[8];
+            alignas(32) float fx[8], fy[8], fx1[8], fy1[8];
+            _mm256_store_si256((__m256i *)xs, taps.x);
+            _mm256_store_si256((__m256i *)ys, taps.y);
+            _mm256_store_ps(fx, w.fx);
+            _mm256_store_ps(fy, w.fy);
+            _mm256_store_ps(fx1, w.fx1);
+            _mm256_store_ps(fy1, w.fy1);
+
+            const char *origin = (const char *)src.origin;
+            for (int k = 0; k < 8; k++) {
+                const char *a = origin + ys[k] * src.rowBytes + xs[k] * 16;
+                const __m256 weightX = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(fx1[k])), _mm_set1_ps(fx[k]), 1);
+                const __m256 top = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps((const float *)a), weightX), _mm256_set1_ps(fy1[k]));
+                const __m256 bottom = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps((const float *)(a + src.rowBytes)), weightX), _mm256_set1_ps(fy[k]));
+                __m128 sum = _mm_add_ps(_mm256_castps256_ps128(top), _mm256_extractf128_ps(top, 1));
+                sum = _mm_add_ps(sum, _mm256_castps256_ps128(bottom));
+                sum = _mm_add_ps(sum, _mm256_extractf128_ps(bottom, 1));
+                _mm_storeu_ps((float *)(dst + 16 * k), sum);
+            }
+        }
+    };
+
+    // Float with 1 or 3 components: each component of each tap gathered for 8 pixels at once
+    template <int nComponents>
+    struct FloatGather {
+        static const int kPixelBytes = 4 * nComponents;
+
+        static void resample(const BilinearSource &src, const BilinearTaps &taps, char *dst)
+        {
+            const FloatWeights w(taps);
+            const int rowFloats = (int)(src.rowBytes / 4);
+            const __m256i index00 = _mm256_add_epi32(_mm256_mullo_epi32(taps.y, _mm256_set1_epi32(rowFloats)),
+                                                     _mm256_mullo_epi32(taps.x, _mm256_set1_epi32(nComponents)));
+            const __m256i index01 = _mm256_add_epi32(index00, _mm256_set1_epi32(rowFloats));
+            const float *origin = (const float *)src.origin;
+
+            alignas(32) float values[nComponents][8];
+            for (int c = 0; c < nComponents; c++) {
+                const __m256i c00 = _mm256_add_epi32(index00, _mm256_set1_epi32(c));
+                const __m256i c10 = _mm256_add_epi32(index00, _mm256_set1_epi32(c + nComponents));
+                const __m256i c01 = _mm256_add_epi32(index01, _mm256_set1_epi32(c));
+                const __m256i c11 = _mm256_add_epi32(index01, _mm256_set1_epi32(c + nComponents));
+                __m256 sum = _mm256_mul_ps(_mm256_mul_ps(_mm256_i32gather_ps(origin, c00, 4), w.fx1), w.fy1);
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(_mm256_i32gather_ps(origin, c10, 4), w.fx), w.fy1));
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(_mm256_i32gather_ps(origin, c01, 4), w.fx1), w.fy));
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(_mm256_i32gather_ps(origin, c11, 4), w.fx), w.fy));
+                _mm256_store_ps(values[c], sum);
+            }
+            float *dstPix = (float *)dst;
+            for (int k = 0; k < 8; k++) {
+                for (int c = 0; c < nComponents; c++) {
+                    dstPix[nComponents * k + c] = values[c][k];
+                }
+            }
+        }
+    };
+
+    // The row in blocks of 8 pixels, the last one padded with zero offsets and written through
+    // a buffer
+    template <class Format>
+    int bilinearRow(const BilinearSource &src, int y, int x1, int x2, const float *offsets, void *dstPix, int *edgePixels)
+    {
+        char *dst = (char *)dstPix;
+        int nEdgePixels = 0;
+        for (int x = x1; x < x2; x += 8) {
+            const int i = x - x1;
+            const int n = x2 - x < 8 ? x2 - x : 8;
+            int edgeMask;
+            if (n == 8) {
+                const BilinearTaps taps = getBilinearTaps(src, x, y, offsets + 2 * i);
+                Format::resample(src, taps, dst + i * Format::kPixelBytes);
+                edgeMask = taps.edgeMask;
+            } else {
+                alignas(32) float tailOffsets[16] = {};
+                alignas(32) char tail[8 * Format::kPixelBytes];
+                for (int k = 0; k < 2 * n; k++) {
+                    tailOffsets[k] = offsets[2 * i + k];
+                }
+                const BilinearTaps taps = getBilinearTaps(src, x, y, tailOffsets);
+                Format::resample(src, taps, tail);
+                for (int k = 0; k < n * Format::kPixelBytes; k++) {
+                    dst[i * Format::kPixelBytes + k] = tail[k];
+                }
+                edgeMask = taps.edgeMask & ((1 << n) - 1);
+            }
+            for (int k = 0; edgeMask; k++, edgeMask >>= 1) {
+                if (edgeMask & 1) {
+                    edgePixels[nEdgePixels++] = i + k;
+                }
+            }
+        }
+        return nEdgePixels;
+    }
+
+}
+
+namespace FluidSwirlSIMD {
+
+    void radialSwirlTableRowAVX2(const RadialSwirlParams &params, int y, int x1, int x2, float *offsets)
+    {
+        radialSwirlTableRow<AVX2>(params, y, x1, x2, offsets);
+    }
+
+    int bilinearRowUByte4AVX2(const BilinearSource &src, int y, int x1, int x2, const float *offsets,
+                              void *dstPix, int *edgePixels)
+    {
+        return bilinearRow<UByte4>(src, y, x1, x2, offsets, dstPix, edgePixels);
+    }
+
+    int bilinearRowFloat1AVX2(const BilinearSource &src, int y, int x1, int x2, const float *offsets,
+                              void *dstPix, int *edgePixels)
+    {
+        return bilinearRow<FloatGather<1> >(src, y, x1, x2, offsets, dstPix, edgePixels);
+    }
+
+    int bilinearRowFloat3AVX2(const BilinearSource &src, int y, int x1, int x2, const float *offsets,
+                              void *dstPix, int *edgePixels)
+    {
+        return bilinearRow<FloatGather<3> >(src, y, x1, x2, offsets, dstPix, edgePixels);
+    }
+
+    int bilinearRowFloat4AVX2(const BilinearSource &src, int y, int x1, int x2, const float *offsets,
+                              void *dstPix, int *edgePixels)
+    {
+        return bilinearRow<Float4>(src, y, x1, x2, offsets, dstPix, edgePixels);
+    }
+
+}
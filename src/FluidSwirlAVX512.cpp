@@ -0,0 +1,61 @@
+// AVX-512F kernels, 16 pixels per iteration. Built with -mavx512f (/arch:AVX512 on MSVC),
+// called only after the dispatch in FluidSwirlSIMD.cpp has checked the CPU.
+
+#include <immintrin.h>
+
+#include "FluidSwirlSIMDKernels.hpp"
+
+namespace {
+
+    struct AVX512 {
+        typedef __m512 F;
+        typedef __m512i I;
+        static const int kWidth = 16;
+
+        static F set1(float v) { return _mm512_set1_ps(v); }
+        static I set1i(int v) { return _mm512_set1_epi32(v); }
+        static F ramp(float v)
+        {
+            return _mm512_add_ps(_mm512_set1_ps(v), _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        }
+        static void store(float *p, F v) { _mm512_store_ps(p, v); }
+
+        static F add(F a, F b) { return _mm512_add_ps(a, b); }
+        static F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+        static F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+        static F max(F a, F b) { return _mm512_max_ps(a, b); }
+        static F sqrt(F a) { return _mm512_sqrt_ps(a); }
+        static F fmadd(F a, F b, F c) { return _mm512_fmadd_ps(a, b, c); }
+        static F fmsub(F a, F b, F c) { return _mm512_fmsub_ps(a, b, c); }
+        static F roundNearest(F a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+
+        static I toInt(F a) { return _mm512_cvtps_epi32(a); }
+        static F asFloat(I a) { return _mm512_castsi512_ps(a); }
+        static I addi(I a, I b) { return _mm512_add_epi32(a, b); }
+        static I andi(I a, I b) { return _mm512_and_si512(a, b); }
+        static I shiftLeft23(I a) { return _mm512_slli_epi32(a, 23); }
+        static I shiftLeft30(I a) { return _mm512_slli_epi32(a, 30); }
+
+        // ifNonZero where cond != 0, ifZero elsewhere
+        static F select(I cond, F ifNonZero, F ifZero)
+        {
+            return _mm512_mask_blend_ps(_mm512_test_epi32_mask(cond, cond), ifZero, ifNonZero);
+        }
+
+        // flips the sign of the lanes whose signBits has bit 31 set (integer xor, _mm512_xor_ps needs AVX512DQ)
+        static F flipSign(F a, I signBits)
+        {
+            return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), signBits));
+        }
+    };
+
+}
+
+namespace FluidSwirlSIMD {
+
+    void radialSwirlRowAVX512(const RadialSwirlParams &params, int y, int x1, int x2, float *offsets)
+    {
+        radialSwirlRow<AVX512>(params, y, x1, x2, offsets);
+    }
+
+}
@@ -0,0 +1,64 @@
+// F16C half float conversions. Built with -mf16c (/arch:AVX on MSVC), called only after
+// FluidSwirlSIMD::hasF16C has checked the CPU. Deliberately includes nothing but the
+// intrinsics, so no inline or template code shared with other files gets compiled here.
+
+#include <immintrin.h>
+
+#include <cstddef>
+
+namespace FluidSwirlHalf {
+
+    namespace {
+
+        // Up to 4 halves into the low lanes, without reading past the pixel
+        inline __m128 loadPixel(const unsigned short *p, int nComponents)
+        {
+            __m128i bits;
+            if (nComponents == 4) {
+                bits = _mm_loadl_epi64((const __m128i *)p);
+            } else if (nComponents == 3) {
+                bits = _mm_setr_epi16((short)p[0], (short)p[1], (short)p[2], 0, 0, 0, 0, 0);
+            } else {
+                bits = _mm_cvtsi32_si128(p[0]);
+            }
+            return _mm_cvtph_ps(bits);
+        }
+
+        inline __m128 bilinear(const unsigned short *p00, const unsigned short *p10, const unsigned short *p01,
+                               const unsigned short *p11, int nComponents, float fx, float fy)
+        {
+            const __m128 fxV = _mm_set1_ps(fx);
+            const __m128 fyV = _mm_set1_ps(fy);
+            const __m128 fx1V = _mm_set1_ps(1.0f - fx);
+            const __m128 fy1V = _mm_set1_ps(1.0f - fy);
+
+            const __m128 top = _mm_add_ps(_mm_mul_ps(loadPixel(p00, nComponents), fx1V), _mm_mul_ps(loadPixel(p10, nComponents), fxV));
+            const __m128 bottom = _mm_add_ps(_mm_mul_ps(loadPixel(p01, nComponents), fx1V), _mm_mul_ps(loadPixel(p11, nComponents), fxV));
+            return _mm_add_ps(_mm_mul_ps(top, fy1V), _mm_mul_ps(bottom, fyV));
+        }
+
+    }
+
+    void bilinearF16C(const unsigned short *p00, const unsigned short *p10, const unsigned short *p01,
+                      const unsigned short *p11, int nComponents, float fx, float fy, unsigned short *dstPix)
+    {
+        const __m128i result = _mm_cvtps_ph(bilinear(p00, p10, p01, p11, nComponents, fx, fy), _MM_FROUND_TO_NEAREST_INT);
+
+        if (nComponents == 4) {
+            _mm_storel_epi64((__m128i *)dstPix, result);
+        } else {
+            alignas(16) unsigned short halves[8];
+            _mm_store_si128((__m128i *)halves, result);
+            for (int c = 0; c < nComponents; c++) {
+                dstPix[c] = halves[c];
+            }
+        }
+    }
+
+    void bilinearSampleF16C(const unsigned short *p00, const unsigned short *p10, const unsigned short *p01,
+                            const unsigned short *p11, int nComponents, float fx, float fy, float *values)
+    {
+        _mm_storeu_ps(values, bilinear(p00, p10, p01, p11, nComponents, fx, fy));
+    }
+
+}
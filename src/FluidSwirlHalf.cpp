@@ -0,0 +1,58 @@
+// Half float kernels, with portable and with F16C bilinear taps. Built without any
+// instruction set flags like the rest of the kernels; the F16C code is in FluidSwirlF16C.cpp.
+
+#include "FluidSwirlHalf.hpp"
+
+namespace FluidSwirlHalf {
+
+    namespace {
+
+        template <bool useF16C, int nComponents>
+        FluidSwirlKernelBase *createKernel(int flowMode)
+        {
+            typedef FluidSwirlHalfPixel<useF16C> PIX;
+            switch (flowMode) {
+                case 0:
+                    return new FluidSwirlKernel<PIX, nComponents, 1, 0>;
+                case 1:
+                    return new FluidSwirlKernel<PIX, nComponents, 1, 1>;
+                case 2:
+                    return new FluidSwirlKernel<PIX, nComponents, 1, 2>;
+                default:
+                    return NULL;
+            }
+        }
+
+        template <bool useF16C>
+        FluidSwirlKernelBase *createKernel(int nComponents, int flowMode)
+        {
+            switch (nComponents) {
+                case 4:
+                    return createKernel<useF16C, 4>(flowMode);
+                case 3:
+                    return createKernel<useF16C, 3>(flowMode);
+                case 1:
+                    return createKernel<useF16C, 1>(flowMode);
+                default:
+                    return NULL;
+            }
+        }
+
+    }
+
+    FluidSwirlKernelBase *createKernel(int nComponents, int flowMode)
+    {
+#ifdef FLUIDSWIRL_X86_SIMD
+        if (FluidSwirlSIMD::hasF16C()) {
+            return createKernel<true>(nComponents, flowMode);
+        }
+#endif
+        return createKernel<false>(nComponents, flowMode);
+    }
+
+    const char *getConversionName()
+    {
+        return FluidSwirlSIMD::hasF16C() ? "F16C" : "portable";
+    }
+
+}
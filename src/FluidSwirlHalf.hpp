@@ -0,0 +1,181 @@
+#pragma once
+
+// Half float (IEEE 754 binary16) pixels for FluidSwirlKernel.
+//
+// FluidSwirlHalfPixel is the component type the half kernels are instantiated with. It
+// converts to float on load and back (rounding to nearest even) on store, so the kernels
+// compute in float and only the memory traffic stays 16-bit. With useF16C the bilinear taps,
+// and the wake diffusion taps, go through the F16C routines in FluidSwirlF16C.cpp instead;
+// that file is compiled with F16C enabled and holds nothing else, so none of the kernel
+// code can end up with instructions the CPU may lack. createKernel picks the F16C kernels
+// only after checking the CPU.
+
+#include "FluidSwirlKernel.hpp"
+
+#include <cstring>
+
+namespace FluidSwirlHalf {
+
+    // Exponent rebias with the denormals renormalised through a float subtraction, after
+    // F. Giesen's half_to_float_fast
+    inline float toFloat(unsigned short h)
+    {
+        const unsigned int shiftedExponent = 0x7c00u << 13;
+        const unsigned int magicBits = 113u << 23;
+        unsigned int u = (h & 0x7fffu) << 13;
+        const unsigned int exponent = u & shiftedExponent;
+        u += (127u - 15u) << 23;
+        if (exponent == shiftedExponent) {
+            // Inf or NaN
+            u += (128u - 16u) << 23;
+        } else if (exponent == 0) {
+            // zero or denormal
+            u += 1u << 23;
+            float f, magic;
+            memcpy(&f, &u, sizeof(f));
+            memcpy(&magic, &magicBits, sizeof(magic));
+            f -= magic;
+            memcpy(&u, &f, sizeof(u));
+        }
+        u |= (h & 0x8000u) << 16;
+        float f;
+        memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+
+    // Round to nearest even, overflow gives Inf and NaN stays NaN, after F. Giesen's
+    // float_to_half_fast3_rtne
+    inline unsigned short fromFloat(float value)
+    {
+        const unsigned int infinityBits = 255u << 23;
+        const unsigned int overflowBits = (127u + 16u) << 23;
+        const unsigned int denormalMagicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+        unsigned int u;
+        memcpy(&u, &value, sizeof(u));
+        const unsigned int sign = u & 0x80000000u;
+        u ^= sign;
+
+        unsigned int h;
+        if (u >= overflowBits) {
+            h = u > infinityBits ? 0x7e00u : 0x7c00u;
+        } else if (u < (113u << 23)) {
+            // denormal or zero, the float adder rounds the mantissa into place
+            float f, magic;
+            memcpy(&f, &u, sizeof(f));
+            memcpy(&magic, &denormalMagicBits, sizeof(magic));
+            f += magic;
+            memcpy(&u, &f, sizeof(u));
+            h = u - denormalMagicBits;
+        } else {
+            const unsigned int mantissaOdd = (u >> 13) & 1;
+            u += ((15u - 127u) << 23) + 0xfffu;
+            u += mantissaOdd;
+            h = u >> 13;
+        }
+        return (unsigned short)(h | (sign >> 16));
+    }
+
+#ifdef FLUIDSWIRL_X86_SIMD
+    // Bilinear tap of one pixel with nComponents (1, 3 or 4) half components, converted with
+    // F16C and interpolated in float, stored as halves or returned as floats. Only valid on
+    // CPUs with F16C.
+    void bilinearF16C(const unsigned short *p00, const unsigned short *p10, const unsigned short *p01,
+                      const unsigned short *p11, int nComponents, float fx, float fy, unsigned short *dstPix);
+    void bilinearSampleF16C(const unsigned short *p00, const unsigned short *p10, const unsigned short *p01,
+                            const unsigned short *p11, int nComponents, float fx, float fy, float *values);
+#endif
+
+}
+
+template <bool useF16C>
+struct FluidSwirlHalfPixel
+{
+    unsigned short bits;
+
+    FluidSwirlHalfPixel() {}
+    FluidSwirlHalfPixel(float value) : bits(FluidSwirlHalf::fromFloat(value)) {}
+    operator float() const { return FluidSwirlHalf::toFloat(bits); }
+
+    template <int nComponents, class Real>
+    static void bilinear(const FluidSwirlHalfPixel *p00, const FluidSwirlHalfPixel *p10,
+                         const FluidSwirlHalfPixel *p01, const FluidSwirlHalfPixel *p11,
+                         Real fx, Real fy, FluidSwirlHalfPixel *dstPix)
+    {
+#ifdef FLUIDSWIRL_X86_SIMD
+        if (useF16C) {
+            FluidSwirlHalf::bilinearF16C(&p00->bits, &p10->bits, &p01->bits, &p11->bits, nComponents,
+                                         (float)fx, (float)fy, &dstPix->bits);
+            return;
+        }
+#endif
+        const Real fx1 = 1 - fx;
+        const Real fy1 = 1 - fy;
+        for (int c = 0; c < nComponents; c++) {
+            const Real interpolated = p00[c] * fx1 * fy1 +
+                                      p10[c] * fx * fy1 +
+                                      p01[c] * fx1 * fy +
+                                      p11[c] * fx * fy;
+            dstPix[c] = FluidSwirlHalfPixel((float)interpolated);
+        }
+    }
+
+    template <int nComponents, class Real>
+    static void bilinearSample(const FluidSwirlHalfPixel *p00, const FluidSwirlHalfPixel *p10,
+                               const FluidSwirlHalfPixel *p01, const FluidSwirlHalfPixel *p11,
+                               Real fx, Real fy, Real *values)
+    {
+#ifdef FLUIDSWIRL_X86_SIMD
+        if (useF16C) {
+            float sample[4];
+            FluidSwirlHalf::bilinearSampleF16C(&p00->bits, &p10->bits, &p01->bits, &p11->bits, nComponents,
+                                               (float)fx, (float)fy, sample);
+            for (int c = 0; c < nComponents; c++) {
+                values[c] = sample[c];
+            }
+            return;
+        }
+#endif
+        const Real fx1 = 1 - fx;
+        const Real fy1 = 1 - fy;
+        for (int c = 0; c < nComponents; c++) {
+            values[c] = p00[c] * fx1 * fy1 +
+                        p10[c] * fx * fy1 +
+                        p01[c] * fx1 * fy +
+                        p11[c] * fx * fy;
+        }
+    }
+};
+
+// Bilinear taps for half pixels, see bilinearPixel and bilinearSample in FluidSwirlKernel.hpp
+template <int nComponents, bool useF16C, class Real>
+inline void bilinearPixel(const FluidSwirlHalfPixel<useF16C> *p00, const FluidSwirlHalfPixel<useF16C> *p10,
+                          const FluidSwirlHalfPixel<useF16C> *p01, const FluidSwirlHalfPixel<useF16C> *p11,
+                          Real fx, Real fy, FluidSwirlHalfPixel<useF16C> *dstPix)
+{
+    FluidSwirlHalfPixel<useF16C>::template bilinear<nComponents>(p00, p10, p01, p11, fx, fy, dstPix);
+}
+
+template <int nComponents, bool useF16C, class Real>
+inline void bilinearSample(const FluidSwirlHalfPixel<useF16C> *p00, const FluidSwirlHalfPixel<useF16C> *p10,
+                           const FluidSwirlHalfPixel<useF16C> *p01, const FluidSwirlHalfPixel<useF16C> *p11,
+                           Real fx, Real fy, Real *values)
+{
+    FluidSwirlHalfPixel<useF16C>::template bilinearSample<nComponents>(p00, p10, p01, p11, fx, fy, values);
+}
+
+template <bool useF16C>
+inline FluidSwirlSIMD::PixelType getPixelType(const FluidSwirlHalfPixel<useF16C> *)
+{
+    return FluidSwirlSIMD::ePixelHalf;
+}
+
+namespace FluidSwirlHalf {
+
+    // Kernel for half float pixels with nComponents (1, 3 or 4) and flowMode, with the F16C
+    // taps when the CPU supports them. NULL for anything else; the caller owns the kernel.
+    FluidSwirlKernelBase *createKernel(int nComponents, int flowMode);
+
+    // "F16C" or "portable", for logging and benchmarks
+    const char *getConversionName();
+
+}
@@ -0,0 +1,1671 @@
+#pragma once
+
+// Per-pixel work of the FluidSwirl plugin: the displacement maths for every flow mode and
+// the resampler, on unchecked OFX::ImageView pixel views (so plain buffers work too).
+// FluidSwirlPlugin.cpp wraps it in an OFX::ImageProcessor; bench/ drives it directly.
+
+#include "ofxsImageEffect.h"
+#include "FluidSwirlSIMD.hpp"
+#include "FluidSwirlPyramid.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Per-pixel source positions for a window of the output, stored as offsets from the
+// pixel itself, plus the flow mode 2 wake blur amount. Built during a render and kept
+// by the instance, so frames whose displacement key is unchanged skip the swirl maths.
+struct FluidSwirlDisplacementField
+{
+    std::vector<double> key;
+    OfxRectI bounds;
+    std::vector<float> offsets;     // (srcX - x, srcY - y) pairs, row-major over bounds
+    std::vector<float> wakeBlur;    // one per pixel, flow mode 2 only
+};
+
+// Parameter values at one time, with positions and sizes converted to pixels of the
+// source frame by FluidSwirlPlugin::getPixelParams (or a benchmark)
+struct FluidSwirlParams
+{
+    double swirlIntensity;
+    double centerX, centerY;
+    double radius;
+    double decay;
+    double flowDirection;
+    double flowStrength;
+    double wakeWidth;
+    double vortexSpacing;
+    int flowMode;
+    double projectileStartX, projectileStartY;
+    double projectileEndX, projectileEndY;
+    double projectileSpeed;
+    double projectileRadius;
+    double wakeDecay;
+    double time;
+};
+
+// Per-frame state of the projectile wake (flow mode 2): everything the per-pixel maths needs
+// that only depends on the parameters and the time. Each feature also gets a box bounding
+// the pixels it can displace or blur, with a pixel of slack for rounding, so a pixel only
+// evaluates the features whose box it lies in.
+struct FluidSwirlProjectileState
+{
+    enum Feature {
+        eWave = 1,      // expanding wave around the start point
+        eImpact = 2,    // pull and ripples around the projectile
+        eWake = 4       // trail from the start point to the projectile
+    };
+    
+    double progress;
+    double x, y;                    // current projectile position
+    double dirX, dirY;              // trajectory direction, normalised unless degenerate
+    double waveRadius;
+    double waveDisplacementDecay;   // exp(-progress / (2 * wakeDecay))
+    double waveBlurDecay;           // exp(-progress / wakeDecay)
+    double wakeLength;
+    double wakeDirX, wakeDirY;      // start point to projectile, normalised
+    double dynamicWakeWidth;        // wake blur width, grows with progress
+    
+    unsigned int features;          // features that can affect any pixel at all
+    OfxRectD waveBox, impactBox, wakeBox;
+    
+    // Features whose box contains row y, or pixel (x, y)
+    unsigned int getRowFeatures(double y) const
+    {
+        return (features & eWave && y >= waveBox.y1 && y <= waveBox.y2 ? eWave : 0) |
+               (features & eImpact && y >= impactBox.y1 && y <= impactBox.y2 ? eImpact : 0) |
+               (features & eWake && y >= wakeBox.y1 && y <= wakeBox.y2 ? eWake : 0);
+    }
+    unsigned int getPixelFeatures(unsigned int rowFeatures, double x) const
+    {
+        return (rowFeatures & eWave && x >= waveBox.x1 && x <= waveBox.x2 ? eWave : 0) |
+               (rowFeatures & eImpact && x >= impactBox.x1 && x <= impactBox.x2 ? eImpact : 0) |
+               (rowFeatures & eWake && x >= wakeBox.x1 && x <= wakeBox.x2 ? eWake : 0);
+    }
+    // Features that can reach any pixel of x1..x2, y1..y2 (inclusive)
+    unsigned int getRectFeatures(double x1, double y1, double x2, double y2) const
+    {
+        return (features & eWave && x2 >= waveBox.x1 && x1 <= waveBox.x2 && y2 >= waveBox.y1 && y1 <= waveBox.y2 ? eWave : 0) |
+               (features & eImpact && x2 >= impactBox.x1 && x1 <= impactBox.x2 && y2 >= impactBox.y1 && y1 <= impactBox.y2 ? eImpact : 0) |
+               (features & eWake && x2 >= wakeBox.x1 && x1 <= wakeBox.x2 && y2 >= wakeBox.y1 && y1 <= wakeBox.y2 ? eWake : 0);
+    }
+};
+
+// Everything FluidSwirlKernel needs apart from the pixel format: parameters, source and
+// destination layout, the displacement cache and the per-row displacement maths. Works on
+// plain pixel buffers so it can be driven by the plugin's processor as well as by the
+// microbenchmarks in bench/.
+class FluidSwirlKernelBase
+{
+public:
+    enum ComputePrecision { ePrecisionAuto, ePrecisionSingle, ePrecisionDouble };
+    
+    // What the source looks like beyond the frame: its edge pixels repeated, mirrored or
+    // tiled copies of it, or transparent black
+    enum EdgeMode { eEdgeClamp, eEdgeMirror, eEdgeWrap, eEdgeTransparent };
+    
+protected:
+    double _swirlIntensity;
+    double _centerX, _centerY;
+    double _radius;
+    double _decay;
+    double _flowDirection;
+    double _flowStrength;
+    double _wakeWidth;
+    double _vortexSpacing;
+    int _flowMode;
+    
+    // Projectile parameters
+    double _projectileStartX, _projectileStartY;
+    double _projectileEndX, _projectileEndY;
+    double _projectileSpeed;
+    double _projectileRadius;
+    double _wakeDecayParam;
+    double _currentTime;
+    double _flowCos, _flowSin;
+    FluidSwirlProjectileState _projectile;
+    
+    // Pixels displaced by less than kPassthroughEpsilon (and without wake blur) are copied
+    // straight from the source. Flow mode 0 displaces pixels within _activeRadius of the
+    // centre, flow mode 1 within _activeHalfWidth of the flow line through it; both are
+    // negative when the mode displaces nothing. Flow mode 2 uses the projectile boxes.
+    static constexpr double kPassthroughEpsilon = 1.0 / 1000.0;
+    double _activeRadius;
+    double _activeHalfWidth;
+    
+    // Fast radial swirl row kernel (vector or rotation table), NULL to use the scalar code
+    FluidSwirlSIMD::RadialSwirlRowFunc _radialSwirlRow;
+    FluidSwirlSIMD::RadialSwirlParams _radialSwirlParams;
+    
+    // Whether the resampler may use the vector bilinear row kernels
+    bool _useBilinearRow;
+    
+    // Rotation table behind _radialSwirlParams.table (flow mode 0 only). The entry spacing
+    // keeps the linear interpolation within kRadialTableError pixels of the exact rotation,
+    // unless that would take more than kMaxRadialTableEntries entries (256 KB).
+    static constexpr double kRadialTableError = 1.0 / 2000.0;
+    static const int kMaxRadialTableEntries = 1 << 16;
+    std::vector<float> _radialSwirlTable;
+    
+    // The wake diffusion (flow mode 2) averages a pixel with wake blur amount b over a box
+    // kWakeBlurBoxWidth * b pixels wide (about the spread of 8 taps along a spiral out to 6 b),
+    // and with _antialiasing every pixel is averaged over the source area its neighbours
+    // squeeze into it. Both are fetched trilinearly from _sourcePyramid, which the first
+    // pixel that needs it builds over _sourcePyramidRegion (see getSourcePyramid), so
+    // renders without either build nothing. prepareSource sets the region up per render:
+    // the fetched source with antialiasing, otherwise the source pixels the wake can blur
+    // (the feature boxes grown by _displacementBound, the reach of the displacement).
+    static constexpr double kWakeBlurBoxWidth = 7.7;
+    bool _antialiasing;
+    FluidSwirlMipPyramid _sourcePyramid;
+    OfxRectI _sourcePyramidRegion;
+    int _sourcePyramidLevels;
+    std::atomic<bool> _sourcePyramidReady;
+    std::mutex _sourcePyramidMutex;
+    double _displacementBound;
+    
+    // Adaptive displacement grid: with a cell size above 1 the exact displacement is only
+    // computed every _gridCellSize pixels and interpolated in the cells where that stays
+    // within kGridTolerance pixels (see computeSourceBlock)
+    static constexpr double kGridTolerance = 1.0 / 20.0;
+    int _gridCellSize;
+    
+    // One exact displacement sample of the adaptive grid. region tells apart the sides of
+    // every crease and jump of the displacement maths (see sampleDisplacement).
+    struct GridSample {
+        double offsetX, offsetY, wakeBlur;
+        unsigned int region;
+        
+        static GridSample lerp(const GridSample &a, const GridSample &b, double t)
+        {
+            const GridSample value = { a.offsetX + t * (b.offsetX - a.offsetX), a.offsetY + t * (b.offsetY - a.offsetY),
+                                       a.wakeBlur + t * (b.wakeBlur - a.wakeBlur), a.region };
+            return value;
+        }
+        
+        // The wake blur box reaches half its width from the pixel
+        static bool isClose(const GridSample &a, const GridSample &b)
+        {
+            return a.region == b.region &&
+                   fabs(a.offsetX - b.offsetX) <= kGridTolerance && fabs(a.offsetY - b.offsetY) <= kGridTolerance &&
+                   0.5 * kWakeBlurBoxWidth * fabs(a.wakeBlur - b.wakeBlur) <= kGridTolerance;
+        }
+    };
+    
+    // Grid samples taken on first use
+    class GridSamples {
+        std::vector<GridSample> _samples;
+        std::vector<bool> _taken;
+        
+    public:
+        explicit GridSamples(int count) : _samples(count), _taken(count, false) {}
+        
+        template <int flowMode>
+        const GridSample &get(const FluidSwirlKernelBase &kernel, int index, int x, int y)
+        {
+            if (!_taken[index]) {
+                _samples[index] = kernel.sampleDisplacement<flowMode>(x, y);
+                _taken[index] = true;
+            }
+            return _samples[index];
+        }
+    };
+    
+    // Precision of the coordinate maths and the resampler. Float keeps about 1/1000 pixel
+    // wherever every frame coordinate is below kSinglePrecisionLimit, which is where
+    // ePrecisionAuto uses it; larger coordinates fall back to double. The projectile wake
+    // always uses double under ePrecisionAuto: its radius and width tests are hard edges,
+    // and float rounding moves pixels across them by whole displacements.
+    static constexpr double kSinglePrecisionLimit = 16384.0;
+    ComputePrecision _computePrecision;
+    
+    // Source and destination pixels, as unchecked views so pixel fetches need no calls.
+    // _imageBounds is the whole source frame, beyond which _edgeMode takes over; _srcBounds
+    // is the part of it the host actually fetched (one tile plus its apron when tiling) and
+    // limits every read.
+    OFX::ConstImageView _src;
+    OFX::ImageView _dst;
+    OfxRectI _imageBounds;
+    OfxRectI _srcBounds;
+    EdgeMode _edgeMode;
+    
+    // Displacement cache (may be NULL): read when _fieldReady, otherwise filled in
+    // while rendering so the next frame with the same parameters can reuse it.
+    FluidSwirlDisplacementField *_field;
+    bool _fieldReady;
+    
+public:
+    FluidSwirlKernelBase()
+        : _radialSwirlRow(0), _useBilinearRow(false), _antialiasing(false), _sourcePyramidLevels(0), _sourcePyramidReady(false), _displacementBound(1.0), _gridCellSize(1), _computePrecision(ePrecisionAuto), _edgeMode(eEdgeClamp), _field(0), _fieldReady(false) {}
+    virtual ~FluidSwirlKernelBase() {}
+    
+    // Renders the output pixels in window, which must lie inside the destination. Safe to
+    // call from several threads at once for disjoint windows.
+    virtual void processTile(const OfxRectI &window) = 0;
+    
+    // Sets up the source pyramid for this render (built on first use by processTile). Call
+    // after setSrcImage, setSwirlParams and setAntialiasing and before the first processTile.
+    void prepareSource()
+    {
+        if (_antialiasing) {
+            // down to texels as large as the whole source
+            const int size = std::max(_srcBounds.x2 - _srcBounds.x1, _srcBounds.y2 - _srcBounds.y1);
+            _sourcePyramidRegion = _srcBounds;
+            _sourcePyramidLevels = 0;
+            while ((1 << _sourcePyramidLevels) < size) {
+                _sourcePyramidLevels++;
+            }
+        } else {
+            getWakeBlurSource(_sourcePyramidRegion, _sourcePyramidLevels);
+        }
+        _sourcePyramid.clear();
+        _sourcePyramidReady = false;
+    }
+    
+    // Upper bound, in pixels along either axis, on how far from an output pixel the kernel
+    // reads the source: the largest displacement each term of the flow mode can produce, the
+    // wake diffusion on top, and one pixel for the bilinear neighbour.
+    static double getDisplacementBound(const FluidSwirlParams &p)
+    {
+        const double intensity = fabs(p.swirlIntensity);
+        const double strength = fabs(p.flowStrength);
+        
+        if (!(intensity > 0.001 || strength > 0.001)) {
+            return 1.0;
+        }
+        
+        double bound = 0.0;
+        if (p.flowMode == 0) {
+            // Rotating by intensity * exp(-d / decay) moves a pixel at most d times that angle,
+            // which peaks at d = decay
+            if (p.decay > 0.001) {
+                bound = intensity * p.decay * exp(-1.0);
+            }
+        } else if (p.flowMode == 1) {
+            if (p.wakeWidth > 0.001) {
+                bound = strength;
+            }
+        } else {
+            const double progress = p.time / p.projectileSpeed;
+            
+            // expanding wave from the start point, radial plus 0.3 rotational
+            const double wave = intensity * 15.0 * 2.0 * exp(-progress / (p.wakeDecay * 2.0));
+            bound += wave * 1.3;
+            
+            // pull around the projectile: 200 * intensity, 0.3 of that as swirl, plus the vacuum
+            bound += intensity * (200.0 * 1.3 + 30.0);
+            
+            // wake trail: streak (60 * 4 * 3 * 1.4), drag, diffusion and turbulence, with the
+            // wake strength at most the flow strength
+            bound += strength * (60.0 * 4.0 * 3.0 * 1.4 + 25.0 + 3.0 + 12.0);
+            
+            // the wake blur reads the pyramid level at most twice as coarse as its box, whose
+            // bilinear texels lie up to 1.5 texels (3 box widths) away
+            const double blurAmount = strength * std::max(1.0, 0.5 * exp(-progress / p.wakeDecay));
+            bound += blurAmount * 3.0 * kWakeBlurBoxWidth;
+        }
+        
+        return bound + 1.0;
+    }
+    
+    // The source may be smaller than or offset from the destination (it only has to cover the
+    // region of interest). Edge handling happens at the frame border, never at the border of
+    // the fetched pixels, so tiles rendered separately stitch without seams; pixels the host
+    // hands out beyond the frame are ignored, and reads the host fetched too little for are
+    // moved to the nearest fetched pixel.
+    void setSrcImage(const OFX::ConstImageView &src, const OfxRectI &frame)
+    {
+        _src = src;
+        _imageBounds = frame;
+        _srcBounds = src.getBounds();
+        OfxRectI inFrame;
+        inFrame.x1 = std::max(_srcBounds.x1, frame.x1);
+        inFrame.y1 = std::max(_srcBounds.y1, frame.y1);
+        inFrame.x2 = std::min(_srcBounds.x2, frame.x2);
+        inFrame.y2 = std::min(_srcBounds.y2, frame.y2);
+        if (inFrame.x1 < inFrame.x2 && inFrame.y1 < inFrame.y2) {
+            _srcBounds = inFrame;
+        } else {
+            // the source lies outside its own region of definition, treat it as the frame
+            _imageBounds = _srcBounds;
+        }
+    }
+    void setDstImage(const OFX::ImageView &dst) { _dst = dst; }
+    void setUseSIMD(bool v)
+    {
+        _radialSwirlRow = v ? FluidSwirlSIMD::getRadialSwirlRow() : NULL;
+        _useBilinearRow = v;
+    }
+    void setDisplacementGrid(int cellSize) { _gridCellSize = std::max(cellSize, 1); }
+    void setComputePrecision(ComputePrecision precision) { _computePrecision = precision; }
+    void setAntialiasing(bool v) { _antialiasing = v; }
+    void setEdgeMode(EdgeMode mode) { _edgeMode = mode; }
+    
+    // Whether this render computes in float, set up by setSrcImage, setComputePrecision and
+    // the flow mode
+    bool useSinglePrecision() const
+    {
+        if (_computePrecision != ePrecisionAuto) {
+            return _computePrecision == ePrecisionSingle;
+        }
+        return _flowMode != 2 &&
+               std::max(std::max(std::abs(_imageBounds.x1), std::abs(_imageBounds.x2)),
+                        std::max(std::abs(_imageBounds.y1), std::abs(_imageBounds.y2))) < kSinglePrecisionLimit;
+    }
+    
+    // The radial swirl row kernels cost less per pixel than a grid sample, so the grid only
+    // replaces the scalar radial swirl
+    int getGridCellSize() const { return _flowMode == 0 && _radialSwirlRow ? 1 : _gridCellSize; }
+    void setDisplacementField(FluidSwirlDisplacementField *field, bool ready) { _field = field; _fieldReady = ready; }
+    
+    void setSwirlParams(const FluidSwirlParams &p)
+    {
+        _swirlIntensity = p.swirlIntensity;
+        _centerX = p.centerX;
+        _centerY = p.centerY;
+        _radius = p.radius;
+        _decay = p.decay;
+        _flowDirection = p.flowDirection;
+        _flowStrength = p.flowStrength;
+        _wakeWidth = p.wakeWidth;
+        _vortexSpacing = p.vortexSpacing;
+        _flowMode = p.flowMode;
+        
+        // Projectile parameters
+        _projectileStartX = p.projectileStartX;
+        _projectileStartY = p.projectileStartY;
+        _projectileEndX = p.projectileEndX;
+        _projectileEndY = p.projectileEndY;
+        _projectileSpeed = p.projectileSpeed;
+        _projectileRadius = p.projectileRadius;
+        _wakeDecayParam = p.wakeDecay;
+        _currentTime = p.time;
+        
+        // Convert flow direction to radians
+        const double flowDirRad = _flowDirection * M_PI / 180.0;
+        _flowCos = cos(flowDirRad);
+        _flowSin = sin(flowDirRad);
+        
+        // Same cut-offs as computeSourcePosition: no swirl at all below the intensity
+        // threshold or when the decay is too small to divide by
+        const bool radialSwirl = (fabs(_swirlIntensity) > 0.001 || fabs(_flowStrength) > 0.001) && _decay > 0.001;
+        _radialSwirlParams.centerX = _centerX;
+        _radialSwirlParams.centerY = _centerY;
+        _radialSwirlParams.intensity = radialSwirl ? (float)_swirlIntensity : 0.0f;
+        _radialSwirlParams.invDecay = radialSwirl ? (float)(1.0 / _decay) : 0.0f;
+        
+        setProjectileState();
+        setActiveRegion();
+        setRadialSwirlTable();
+        _displacementBound = getDisplacementBound(p);
+    }
+    
+    // Source pixels the wake diffusion can read (the hull of the projectile feature boxes
+    // grown by the displacement bound, within the fetched pixels) and the number of pyramid
+    // levels its largest blur box needs. Empty or 0 when nothing gets blurred.
+    void getWakeBlurSource(OfxRectI &region, int &nLevels) const
+    {
+        region.x1 = region.y1 = region.x2 = region.y2 = 0;
+        nLevels = 0;
+        const double maxBlur = fabs(_flowStrength) * std::max(1.0, 0.5 * _projectile.waveBlurDecay);
+        if (_flowMode != 2 || !(fabs(_swirlIntensity) > 0.001 || fabs(_flowStrength) > 0.001) ||
+            !(kWakeBlurBoxWidth * maxBlur > 1.0)) {
+            return;
+        }
+        
+        const OfxRectD *const boxes[] = { &_projectile.waveBox, &_projectile.impactBox, &_projectile.wakeBox };
+        const unsigned int bits[] = { FluidSwirlProjectileState::eWave, FluidSwirlProjectileState::eImpact, FluidSwirlProjectileState::eWake };
+        OfxRectD hull = { 0.0, 0.0, 0.0, 0.0 };
+        bool any = false;
+        for (int i = 0; i < 3; i++) {
+            if (_projectile.features & bits[i]) {
+                hull.x1 = any ? std::min(hull.x1, boxes[i]->x1) : boxes[i]->x1;
+                hull.y1 = any ? std::min(hull.y1, boxes[i]->y1) : boxes[i]->y1;
+                hull.x2 = any ? std::max(hull.x2, boxes[i]->x2) : boxes[i]->x2;
+                hull.y2 = any ? std::max(hull.y2, boxes[i]->y2) : boxes[i]->y2;
+                any = true;
+            }
+        }
+        if (!any) {
+            return;
+        }
+        
+        region.x1 = (int)std::max((double)_srcBounds.x1, floor(hull.x1 - _displacementBound));
+        region.y1 = (int)std::max((double)_srcBounds.y1, floor(hull.y1 - _displacementBound));
+        region.x2 = (int)std::min((double)_srcBounds.x2, ceil(hull.x2 + _displacementBound));
+        region.y2 = (int)std::min((double)_srcBounds.y2, ceil(hull.y2 + _displacementBound));
+        if (region.x1 < region.x2 && region.y1 < region.y2) {
+            nLevels = std::min(24, (int)ceil(log2(kWakeBlurBoxWidth * maxBlur)));
+        }
+    }
+    
+    // Fills _radialSwirlTable out to _activeRadius, beyond which the swirl moves no pixel by
+    // more than kPassthroughEpsilon. Along the distance d the rotation (cos s, sin s) with
+    // s = I exp(-d / decay) has a second derivative of at most s'^2 + |s''| = (s^2 + |s|) / decay^2,
+    // so interpolating with spacing h moves a pixel by at most
+    //     d h^2 / (8 decay^2) (s^2 + |s|) <= h^2 / (8 e decay) (I^2 / 2 + |I|)
+    // which gives the spacing for kRadialTableError.
+    void setRadialSwirlTable()
+    {
+        _radialSwirlTable.clear();
+        _radialSwirlParams.table = NULL;
+        _radialSwirlParams.tableScale = 0.0f;
+        _radialSwirlParams.tableSize = 0;
+        if (_flowMode != 0) {
+            return;
+        }
+        
+        // a single zero entry when nothing moves by kPassthroughEpsilon
+        int last = 0;
+        double spacing = 0.0;
+        if (_activeRadius > 0.0) {
+            const double intensity = fabs(_swirlIntensity);
+            spacing = sqrt(8.0 * exp(1.0) * _decay * kRadialTableError / (0.5 * intensity * intensity + intensity));
+            last = std::max(1, (int)ceil(_activeRadius / spacing));
+            if (last > kMaxRadialTableEntries - 2) {
+                last = kMaxRadialTableEntries - 2;
+                spacing = _activeRadius / last;
+            }
+        }
+        
+        // entries 0..last sample the rotation, entry last + 1 is the zero it fades to
+        const int stride = FluidSwirlSIMD::kRadialTableStride;
+        const int size = last > 0 ? last + 2 : 1;
+        _radialSwirlTable.assign((size_t)stride * size, 0.0f);
+        const double falloff = last > 0 ? exp(-spacing / _decay) : 0.0;
+        double swirlAngle = _swirlIntensity;
+        for (int i = 0; i + 1 < size; i++, swirlAngle *= falloff) {
+            const double sinHalf = sin(0.5 * swirlAngle);
+            _radialSwirlTable[stride * i] = (float)(-2.0 * sinHalf * sinHalf);
+            _radialSwirlTable[stride * i + 1] = (float)sin(swirlAngle);
+        }
+        for (int i = 0; i + 1 < size; i++) {
+            _radialSwirlTable[stride * i + 2] = _radialSwirlTable[stride * (i + 1)] - _radialSwirlTable[stride * i];
+            _radialSwirlTable[stride * i + 3] = _radialSwirlTable[stride * (i + 1) + 1] - _radialSwirlTable[stride * i + 1];
+        }
+        
+        _radialSwirlParams.table = &_radialSwirlTable[0];
+        _radialSwirlParams.tableScale = last > 0 ? (float)(1.0 / spacing) : 0.0f;
+        _radialSwirlParams.tableSize = size;
+    }
+    
+    void setActiveRegion()
+    {
+        const bool applyEffect = fabs(_swirlIntensity) > 0.001 || fabs(_flowStrength) > 0.001;
+        const double eps = kPassthroughEpsilon;
+        
+        // A pixel at distance d turns by intensity * exp(-d / decay), which moves it by at
+        // most d times that angle. This peaks at d = decay and falls off beyond it, so find
+        // where it drops below eps there (plus a pixel of slack).
+        _activeRadius = -1.0;
+        const double intensity = fabs(_swirlIntensity);
+        if (applyEffect && _decay > 0.001 && intensity * _decay * exp(-1.0) >= eps) {
+            double lo = _decay, hi = 2.0 * _decay;
+            while (intensity * hi * exp(-hi / _decay) >= eps) {
+                lo = hi;
+                hi *= 2.0;
+            }
+            for (int i = 0; i < 64; i++) {
+                const double mid = 0.5 * (lo + hi);
+                if (intensity * mid * exp(-mid / _decay) >= eps) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            _activeRadius = hi + 1.0;
+        }
+        
+        // flowStrength * exp(-perpDist / wakeWidth) drops below eps beyond
+        // wakeWidth * ln(flowStrength / eps) from the flow line
+        _activeHalfWidth = -1.0;
+        const double strength = fabs(_flowStrength);
+        if (applyEffect && _wakeWidth > 0.001 && strength >= eps) {
+            _activeHalfWidth = _wakeWidth * log(strength / eps) + 1.0;
+        }
+    }
+    
+    // Pixels a1..a2-1 of row segment x1..x2-1 that the flow mode can displace (a1 == a2
+    // when there are none); the rest of the segment passes the source through.
+    template <int flowMode>
+    void getActiveSpan(int y, int x1, int x2, int &a1, int &a2) const
+    {
+        double lo = 0.0, hi = -1.0;
+        if (flowMode == 0) {
+            const double dy = y - _centerY;
+            if (fabs(dy) < _activeRadius) {
+                const double halfWidth = sqrt(_activeRadius * _activeRadius - dy * dy);
+                lo = _centerX - halfWidth;
+                hi = _centerX + halfWidth;
+            }
+        } else if (flowMode == 1) {
+            // perpendicular distance |dx * sin - dy * cos| below the half width
+            if (_activeHalfWidth >= 0.0) {
+                const double dy = y - _centerY;
+                if (fabs(_flowSin) > 1e-9) {
+                    const double u1 = (dy * _flowCos - _activeHalfWidth) / _flowSin;
+                    const double u2 = (dy * _flowCos + _activeHalfWidth) / _flowSin;
+                    lo = _centerX + std::min(u1, u2) - 1.0;
+                    hi = _centerX + std::max(u1, u2) + 1.0;
+                } else if (fabs(dy * _flowCos) < _activeHalfWidth) {
+                    lo = x1;
+                    hi = x2;
+                }
+            }
+        } else if (fabs(_swirlIntensity) > 0.001 || fabs(_flowStrength) > 0.001) {
+            // hull of the feature boxes on this row
+            const unsigned int features = _projectile.getRowFeatures(y);
+            const OfxRectD *const boxes[] = { &_projectile.waveBox, &_projectile.impactBox, &_projectile.wakeBox };
+            const unsigned int bits[] = { FluidSwirlProjectileState::eWave, FluidSwirlProjectileState::eImpact, FluidSwirlProjectileState::eWake };
+            bool any = false;
+            for (int i = 0; i < 3; i++) {
+                if (features & bits[i]) {
+                    lo = any ? std::min(lo, boxes[i]->x1) : boxes[i]->x1;
+                    hi = any ? std::max(hi, boxes[i]->x2) : boxes[i]->x2;
+                    any = true;
+                }
+            }
+        }
+        
+        if (hi < lo) {
+            a1 = a2 = x1;
+            return;
+        }
+        a1 = (int)std::max((double)x1, std::min((double)x2, floor(lo)));
+        a2 = (int)std::max((double)a1, std::min((double)x2, ceil(hi) + 1.0));
+    }
+    
+    void setProjectileState()
+    {
+        FluidSwirlProjectileState &s = _projectile;
+        
+        // Calculate projectile position based on time
+        s.progress = (_currentTime / _projectileSpeed);
+        s.x = _projectileStartX + s.progress * (_projectileEndX - _projectileStartX);
+        s.y = _projectileStartY + s.progress * (_projectileEndY - _projectileStartY);
+        
+        s.dirX = _projectileEndX - _projectileStartX;
+        s.dirY = _projectileEndY - _projectileStartY;
+        const double dirLength = sqrt(s.dirX * s.dirX + s.dirY * s.dirY);
+        if (dirLength > 0.001) {
+            s.dirX /= dirLength;
+            s.dirY /= dirLength;
+        }
+        
+        s.waveRadius = std::min(s.progress * _projectileRadius * 4.0, _projectileRadius * 8.0);
+        s.waveDisplacementDecay = exp(-s.progress / (_wakeDecayParam * 2.0));
+        s.waveBlurDecay = exp(-s.progress / _wakeDecayParam);
+        
+        s.wakeLength = sqrt((s.x - _projectileStartX) * (s.x - _projectileStartX) +
+                            (s.y - _projectileStartY) * (s.y - _projectileStartY));
+        s.wakeDirX = s.wakeLength > 0.001 ? (s.x - _projectileStartX) / s.wakeLength : 0.0;
+        s.wakeDirY = s.wakeLength > 0.001 ? (s.y - _projectileStartY) / s.wakeLength : 0.0;
+        s.dynamicWakeWidth = _wakeWidth * (1.0 + s.progress * 2.0);
+        
+        s.features = 0;
+        if (s.waveRadius > 1.0) {
+            // wave displacement and blur both need distance from start < waveRadius
+            s.features |= FluidSwirlProjectileState::eWave;
+            setBox(s.waveBox, _projectileStartX, _projectileStartY, _projectileStartX, _projectileStartY, s.waveRadius);
+        }
+        // pull within projectileRadius, ripples within twice that
+        s.features |= FluidSwirlProjectileState::eImpact;
+        setBox(s.impactBox, s.x, s.y, s.x, s.y, 2.0 * fabs(_projectileRadius));
+        if (s.wakeLength > 0.001) {
+            // both wake widths are distances from the segment start -> projectile
+            s.features |= FluidSwirlProjectileState::eWake;
+            setBox(s.wakeBox, _projectileStartX, _projectileStartY, s.x, s.y,
+                   std::max(_wakeWidth, s.dynamicWakeWidth));
+        }
+    }
+    
+    // Bounding box of the segment (x1, y1) - (x2, y2) grown by reach plus a pixel
+    static void setBox(OfxRectD &box, double x1, double y1, double x2, double y2, double reach)
+    {
+        reach = std::max(reach, 0.0) + 1.0;
+        box.x1 = std::min(x1, x2) - reach;
+        box.y1 = std::min(y1, y2) - reach;
+        box.x2 = std::max(x1, x2) + reach;
+        box.y2 = std::max(y1, y2) + reach;
+    }
+    
+    // Every value computeSourceRow depends on. Time only matters to the moving
+    // projectile, so the other modes reuse one field for a whole static shot.
+    std::vector<double> getDisplacementKey() const
+    {
+        const double values[] = {
+            _swirlIntensity, _centerX, _centerY, _decay, _flowDirection, _flowStrength, _wakeWidth, (double)_flowMode,
+            _projectileStartX, _projectileStartY, _projectileEndX, _projectileEndY,
+            _projectileSpeed, _projectileRadius, _wakeDecayParam, _flowMode == 2 ? _currentTime : 0.0,
+            _radialSwirlRow ? 1.0 : 0.0, (double)getGridCellSize(), useSinglePrecision() ? 1.0 : 0.0
+        };
+        return std::vector<double>(values, values + sizeof(values) / sizeof(values[0]));
+    }
+    
+    // Source offsets (srcX - x, srcY - y pairs) and wake blur for pixels x1..x2-1 of row y.
+    // Points into the displacement cache when there is one, filling it first if it is still
+    // being built, otherwise the row is computed into the caller's scratch buffers.
+    // wakeBlur is NULL outside flow mode 2.
+    template <int flowMode>
+    void getSourceRow(int y, int x1, int x2, float *scratchOffsets, float *scratchBlur,
+                      const float *&offsets, const float *&wakeBlur) const
+    {
+        float *rowOffsets, *rowBlur;
+        getSourceRowStorage<flowMode>(y, x1, scratchOffsets, scratchBlur, rowOffsets, rowBlur);
+        
+        if (!_fieldReady || !_field) {
+            computeSourceRow<flowMode>(y, x1, x2, rowOffsets, rowBlur);
+        }
+        
+        offsets = rowOffsets;
+        wakeBlur = rowBlur;
+    }
+    
+    // Where the offsets and wake blur of row y from pixel x on are kept: in the displacement
+    // cache when there is one, otherwise in the caller's scratch buffers
+    template <int flowMode>
+    void getSourceRowStorage(int y, int x, float *scratchOffsets, float *scratchBlur,
+                             float *&offsets, float *&wakeBlur) const
+    {
+        offsets = scratchOffsets;
+        wakeBlur = flowMode == 2 ? scratchBlur : NULL;
+        
+        if (_field) {
+            const size_t index = (size_t)(y - _field->bounds.y1) * (_field->bounds.x2 - _field->bounds.x1) + (x - _field->bounds.x1);
+            offsets = &_field->offsets[2 * index];
+            wakeBlur = _field->wakeBlur.empty() ? NULL : &_field->wakeBlur[index];
+        }
+    }
+    
+    // floor(v / d) for d > 0, also for negative v
+    static int floorDivide(int v, int d) { return v >= 0 ? v / d : -((-v + d - 1) / d); }
+    
+    // computeSourceRow for every row of block on the adaptive grid. The exact displacement is
+    // sampled at the lattice points on multiples of _gridCellSize in frame coordinates, so
+    // every tile and tile size shares one lattice, and in the middle of every cell and cell
+    // edge. Where all of those middle samples lie within kGridTolerance pixels of the bilinear
+    // interpolation between the corners (the wake blur scaled to its blur radius), in the same
+    // region, the cell is interpolated, otherwise it is computed pixel by pixel. Flow mode 2
+    // cells outside every feature box are left undisplaced without sampling. The cells cover
+    // block but only its pixels are written. offsets and wakeBlur hold one row pointer each,
+    // for block.x1 in every row of block.
+    template <int flowMode>
+    void computeSourceBlock(const OfxRectI &block, float *const *offsets, float *const *wakeBlur) const
+    {
+        const int cellSize = _gridCellSize;
+        const int cellX1 = floorDivide(block.x1, cellSize);
+        const int cellY1 = floorDivide(block.y1, cellSize);
+        const int cellsX = floorDivide(block.x2 - 1, cellSize) + 1 - cellX1;
+        const int cellsY = floorDivide(block.y2 - 1, cellSize) + 1 - cellY1;
+        const int nodesX = cellsX + 1;
+        const int middle = cellSize / 2;
+        const double t = (double)middle / cellSize;
+        
+        // lattice points, middles of the horizontal and of the vertical cell edges, sampled
+        // the first time a cell needs them
+        GridSamples nodes(nodesX * (cellsY + 1));
+        GridSamples rowEdges(cellsX * (cellsY + 1));
+        GridSamples columnEdges(nodesX * cellsY);
+        
+        for (int j = 0; j < cellsY; j++) {
+            const int nodeY = (cellY1 + j) * cellSize;
+            const int y1 = std::max(nodeY, block.y1);
+            const int y2 = std::min(nodeY + cellSize, block.y2);
+            const int yMid = nodeY + middle;
+            for (int i = 0; i < cellsX; i++) {
+                const int nodeX = (cellX1 + i) * cellSize;
+                const int x1 = std::max(nodeX, block.x1);
+                const int x2 = std::min(nodeX + cellSize, block.x2);
+                const int xMid = nodeX + middle;
+                
+                if (flowMode == 2 && !_projectile.getRectFeatures(nodeX, nodeY, nodeX + cellSize - 1, nodeY + cellSize - 1)) {
+                    for (int y = y1; y < y2; y++) {
+                        float *rowOffsets = offsets[y - block.y1] + 2 * (x1 - block.x1);
+                        std::fill(rowOffsets, rowOffsets + 2 * (x2 - x1), 0.0f);
+                        std::fill(wakeBlur[y - block.y1] + (x1 - block.x1), wakeBlur[y - block.y1] + (x2 - block.x1), 0.0f);
+                    }
+                    continue;
+                }
+                
+                const GridSample &n00 = nodes.get<flowMode>(*this, j * nodesX + i, nodeX, nodeY);
+                const GridSample &n10 = nodes.get<flowMode>(*this, j * nodesX + i + 1, nodeX + cellSize, nodeY);
+                const GridSample &n01 = nodes.get<flowMode>(*this, (j + 1) * nodesX + i, nodeX, nodeY + cellSize);
+                const GridSample &n11 = nodes.get<flowMode>(*this, (j + 1) * nodesX + i + 1, nodeX + cellSize, nodeY + cellSize);
+                const bool interpolate =
+                    n00.region == n10.region && n00.region == n01.region && n00.region == n11.region &&
+                    GridSample::isClose(rowEdges.get<flowMode>(*this, j * cellsX + i, xMid, nodeY), GridSample::lerp(n00, n10, t)) &&
+                    GridSample::isClose(rowEdges.get<flowMode>(*this, (j + 1) * cellsX + i, xMid, nodeY + cellSize), GridSample::lerp(n01, n11, t)) &&
+                    GridSample::isClose(columnEdges.get<flowMode>(*this, j * nodesX + i, nodeX, yMid), GridSample::lerp(n00, n01, t)) &&
+                    GridSample::isClose(columnEdges.get<flowMode>(*this, j * nodesX + i + 1, nodeX + cellSize, yMid), GridSample::lerp(n10, n11, t)) &&
+                    GridSample::isClose(sampleDisplacement<flowMode>(xMid, yMid),
+                                        GridSample::lerp(GridSample::lerp(n00, n10, t), GridSample::lerp(n01, n11, t), t));
+                
+                for (int y = y1; y < y2; y++) {
+                    float *rowOffsets = offsets[y - block.y1] + 2 * (x1 - block.x1);
+                    float *rowBlur = flowMode == 2 ? wakeBlur[y - block.y1] + (x1 - block.x1) : NULL;
+                    if (!interpolate) {
+                        computeSourceRow<flowMode>(y, x1, x2, rowOffsets, rowBlur);
+                        continue;
+                    }
+                    const double v = (double)(y - nodeY) / cellSize;
+                    const GridSample left = GridSample::lerp(n00, n01, v);
+                    const GridSample right = GridSample::lerp(n10, n11, v);
+                    for (int x = x1; x < x2; x++) {
+                        const GridSample value = GridSample::lerp(left, right, (double)(x - nodeX) / cellSize);
+                        rowOffsets[2 * (x - x1)] = (float)value.offsetX;
+                        rowOffsets[2 * (x - x1) + 1] = (float)value.offsetY;
+                        if (flowMode == 2) {
+                            rowBlur[x - x1] = (float)value.wakeBlur;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    // computeSourceRow for pixels x1..x2-1 of row y of a neighbouring tile, the way that tile
+    // computes them in pass 1: on the adaptive grid whenever it is on, which is also how the
+    // displacement cache was filled
+    template <int flowMode>
+    void computeNeighbourRow(int y, int x1, int x2, float *offsets, float *wakeBlur) const
+    {
+        if (getGridCellSize() > 1) {
+            const OfxRectI block = { x1, y, x2, y + 1 };
+            computeSourceBlock<flowMode>(block, &offsets, &wakeBlur);
+        } else {
+            computeSourceRow<flowMode>(y, x1, x2, offsets, wakeBlur);
+        }
+    }
+    
+    // Fills offsets and (in flow mode 2) wakeBlur for pixels x1..x2-1 of row y. The radial
+    // swirl goes through the fast row kernel when one was selected, everything else through
+    // computeSourcePosition in the render's precision, rounded to float like the vector path
+    // and the cache.
+    template <int flowMode>
+    void computeSourceRow(int y, int x1, int x2, float *offsets, float *wakeBlur) const
+    {
+        // Check if effect is strong enough to apply
+        if (!(fabs(_swirlIntensity) > 0.001 || fabs(_flowStrength) > 0.001)) {
+            std::fill(offsets, offsets + 2 * (x2 - x1), 0.0f);
+            if (flowMode == 2) {
+                std::fill(wakeBlur, wakeBlur + (x2 - x1), 0.0f);
+            }
+            return;
+        }
+        
+        if (flowMode == 0 && _radialSwirlRow) {
+            _radialSwirlRow(_radialSwirlParams, y, x1, x2, offsets);
+            return;
+        }
+        
+        if (useSinglePrecision()) {
+            computeSourcePositions<flowMode, float>(y, x1, x2, offsets, wakeBlur);
+        } else {
+            computeSourcePositions<flowMode, double>(y, x1, x2, offsets, wakeBlur);
+        }
+    }
+    
+    template <int flowMode, class Real>
+    void computeSourcePositions(int y, int x1, int x2, float *offsets, float *wakeBlur) const
+    {
+        if (flowMode == 2) {
+            // Most of the frame lies outside every feature and keeps zero offsets and blur
+            const unsigned int rowFeatures = _projectile.getRowFeatures(y);
+            for (int x = x1; x < x2; x++) {
+                const unsigned int features = rowFeatures ? _projectile.getPixelFeatures(rowFeatures, x) : 0;
+                Real srcX = x, srcY = y, wakeBlurAmount = 0;
+                if (features) {
+                    computeProjectileWake(x, y, features, srcX, srcY, wakeBlurAmount);
+                }
+                offsets[2 * (x - x1)] = (float)(srcX - x);
+                offsets[2 * (x - x1) + 1] = (float)(srcY - y);
+                wakeBlur[x - x1] = (float)wakeBlurAmount;
+            }
+            return;
+        }
+        
+        for (int x = x1; x < x2; x++) {
+            Real srcX, srcY, wakeBlurAmount;
+            computeSourcePosition<flowMode>(x, y, srcX, srcY, wakeBlurAmount);
+            offsets[2 * (x - x1)] = (float)(srcX - x);
+            offsets[2 * (x - x1) + 1] = (float)(srcY - y);
+            if (flowMode == 2) {
+                wakeBlur[x - x1] = (float)wakeBlurAmount;
+            }
+        }
+    }
+    
+    // The radial swirl is smooth everywhere. The directional flow creases along the flow line,
+    // the projectile maths wherever it branches, which the region records. Samples take the
+    // same culling as computeSourceRow.
+    template <int flowMode>
+    GridSample sampleDisplacement(int x, int y) const
+    {
+        double srcX = x, srcY = y, wakeBlurAmount = 0.0;
+        unsigned int region = 0;
+        if (!(fabs(_swirlIntensity) > 0.001 || fabs(_flowStrength) > 0.001)) {
+            // computeSourceRow leaves everything in place
+        } else if (flowMode == 2) {
+            const unsigned int features = _projectile.getPixelFeatures(_projectile.getRowFeatures(y), x);
+            if (features) {
+                computeProjectileWake(x, y, features, srcX, srcY, wakeBlurAmount, &region);
+                region |= features << 16;
+            }
+        } else {
+            computeSourcePosition<flowMode>(x, y, srcX, srcY, wakeBlurAmount);
+            if (flowMode == 1 && (x - _centerX) * _flowSin - (y - _centerY) * _flowCos < 0) {
+                region = 1;
+            }
+        }
+        const GridSample sample = { srcX - x, srcY - y, wakeBlurAmount, region };
+        return sample;
+    }
+    
+    // Maps output pixel (x, y) to the position it samples in the source image. wakeBlurAmount
+    // is the strength of the flow mode 2 diffusion at that pixel and zero everywhere else.
+    // The flow mode is a template parameter so each instantiation is a single straight path;
+    // Real is the precision of the maths (see useSinglePrecision).
+    template <int flowMode, class Real>
+    void computeSourcePosition(int x, int y, Real &srcX, Real &srcY, Real &wakeBlurAmount) const
+    {
+        srcX = x;
+        srcY = y;
+        wakeBlurAmount = 0;
+        
+        if (flowMode == 0) {
+            // Original radial swirl
+            Real dx = (Real)(x - _centerX);
+            Real dy = (Real)(y - _centerY);
+            Real distance = std::sqrt(dx * dx + dy * dy);
+            
+            Real angle = std::atan2(dy, dx);
+            Real swirlAngle = 0;
+            if (_decay > 0.001) {
+                swirlAngle = (Real)_swirlIntensity * std::exp(-distance / (Real)_decay);
+            }
+            angle += swirlAngle;
+            
+            srcX = (Real)_centerX + distance * std::cos(angle);
+            srcY = (Real)_centerY + distance * std::sin(angle);
+            
+        } else if (flowMode == 1) {
+            // Directional flow
+            Real dx = (Real)(x - _centerX);
+            Real dy = (Real)(y - _centerY);
+            
+            // Distance from flow line (perpendicular distance)
+            Real perpDist = std::fabs(dx * (Real)_flowSin - dy * (Real)_flowCos);
+            Real flowEffect = 0;
+            if (_wakeWidth > 0.001) {
+                flowEffect = (Real)_flowStrength * std::exp(-perpDist / (Real)_wakeWidth);
+            }
+            
+            // Apply flow displacement
+            srcX = x - flowEffect * (Real)_flowCos;
+            srcY = y - flowEffect * (Real)_flowSin;
+            
+        } else if (flowMode == 2) {
+            computeProjectileWake(x, y, _projectile.features, srcX, srcY, wakeBlurAmount);
+        }
+    }
+    
+    // Projectile Wake Effect - like a bullet flying through fluid with expanding waves. Adds
+    // the displacement of each feature in features to (srcX, srcY) and raises wakeBlurAmount
+    // to its diffusion strength; features whose box does not hold (x, y) can be left out, as
+    // they would not change either. branches (when not NULL) receives one bit for every
+    // branch and every side of a line the maths took, which is where the result may jump or
+    // crease; the adaptive grid only interpolates between samples with the same bits.
+    template <class Real>
+    void computeProjectileWake(int x, int y, unsigned int features, Real &srcX, Real &srcY, Real &wakeBlurAmount,
+                               unsigned int *branches = NULL) const
+    {
+        const FluidSwirlProjectileState &s = _projectile;
+        unsigned int taken = 0;
+        
+        // Relative to the start point and the current projectile position
+        const Real startDX = (Real)(x - _projectileStartX);
+        const Real startDY = (Real)(y - _projectileStartY);
+        const Real waveRadius = (Real)s.waveRadius;
+        const Real projectileRadius = (Real)_projectileRadius;
+        const Real wakeWidth = (Real)_wakeWidth;
+        const Real dynamicWakeWidth = (Real)s.dynamicWakeWidth;
+        const Real wakeDirX = (Real)s.wakeDirX, wakeDirY = (Real)s.wakeDirY;
+        const Real swirlIntensity = (Real)_swirlIntensity;
+        const Real flowStrength = (Real)_flowStrength;
+        
+        if (features & FluidSwirlProjectileState::eWave) {
+            Real distFromStart = std::sqrt(startDX * startDX + startDY * startDY);
+            
+            // Apply expanding wave distortion
+            if (distFromStart < waveRadius && distFromStart > Real(0.1)) {
+                taken |= 1u << 0;
+                Real waveDirection = std::atan2(startDY, startDX);
+                Real waveStrength = swirlIntensity * Real(15.0); // Wave displacement strength
+                
+                // Wave front effect - stronger at the edges
+                Real distanceRatio = distFromStart / waveRadius;
+                Real waveFrontEffect = std::sin(distanceRatio * Real(M_PI)) * Real(2.0); // Peak at middle of wave
+                
+                Real totalWaveDisplacement = waveStrength * waveFrontEffect * (Real)s.waveDisplacementDecay;
+                
+                // Apply radial displacement (outward from start point)
+                srcX += std::cos(waveDirection) * totalWaveDisplacement;
+                srcY += std::sin(waveDirection) * totalWaveDisplacement;
+                
+                // Add some rotational component for more fluid-like motion
+                Real rotationalComponent = totalWaveDisplacement * Real(0.3);
+                srcX += -std::sin(waveDirection) * rotationalComponent * std::sin(distFromStart * Real(0.1));
+                srcY += std::cos(waveDirection) * rotationalComponent * std::sin(distFromStart * Real(0.1));
+            }
+            
+            // Expanding wave diffusion
+            if (distFromStart < waveRadius) {
+                taken |= 1u << 1;
+                Real waveStrength = flowStrength * Real(0.5); // Base wave strength
+                
+                // Create ripple effect - stronger at wave fronts
+                Real ripplePhase = (distFromStart / waveRadius) * Real(2.0) * Real(M_PI);
+                Real rippleEffect = (std::sin(ripplePhase * Real(3.0)) + Real(1.0)) * Real(0.5); // 0 to 1
+                
+                // Distance-based falloff
+                Real waveFalloff = Real(1.0) - (distFromStart / waveRadius);
+                waveFalloff = waveFalloff * waveFalloff; // Quadratic falloff
+                
+                Real totalWaveStrength = waveStrength * rippleEffect * waveFalloff * (Real)s.waveBlurDecay;
+                
+                if (totalWaveStrength > wakeBlurAmount) {
+                    taken |= 1u << 2;
+                    wakeBlurAmount = totalWaveStrength;
+                }
+            }
+        }
+        
+        // Distance from current projectile position
+        Real dx = (Real)(x - s.x);
+        Real dy = (Real)(y - s.y);
+        Real distanceFromProjectile = 0;
+        
+        if (features & FluidSwirlProjectileState::eImpact) {
+            distanceFromProjectile = std::sqrt(dx * dx + dy * dy);
+            
+            // Calculate displacement field around current projectile position
+            if (distanceFromProjectile < projectileRadius && distanceFromProjectile > Real(0.1)) {
+                taken |= 1u << 3;
+                const Real dirX = (Real)s.dirX, dirY = (Real)s.dirY;
+                
+                // Calculate EXTREME displacement strength for massive pulling effect
+                Real falloff = std::exp(-distanceFromProjectile / (projectileRadius * Real(0.15))); // Tighter falloff
+                Real baseDisplacement = swirlIntensity * Real(150.0) * falloff; // Almost 2x stronger
+                
+                // Additional "suction" effect - pixels get dragged along more aggressively
+                Real suctionEffect = swirlIntensity * Real(50.0) * falloff;
+                
+                // Pull pixels STRONGLY in projectile direction
+                Real totalDisplacement = baseDisplacement + suctionEffect;
+                
+                // Directional pulling - REVERSED to create forward-flowing streaks
+                srcX -= dirX * totalDisplacement; // NEGATIVE = sample from behind projectile
+                srcY -= dirY * totalDisplacement; // NEGATIVE = sample from behind projectile
+                
+                // Add some perpendicular swirl (but less than before)
+                Real perpX = -dirY;
+                Real perpY = dirX;
+                Real perpDist = std::fabs(dx * perpX + dy * perpY);
+                if ((dx * perpX + dy * perpY) < 0) {
+                    taken |= 1u << 4;
+                }
+                Real swirlAmount = totalDisplacement * Real(0.3) * std::sin(perpDist * Real(0.08)); // Reduced swirl, more drag
+                
+                srcX += perpX * swirlAmount;
+                srcY += perpY * swirlAmount;
+                
+                // Additional "vacuum" effect - sample from even further behind for forward streaks
+                if ((dx * dirX + dy * dirY) < 0) { // Behind projectile
+                    taken |= 1u << 5;
+                    Real vacuumPull = swirlIntensity * Real(30.0) * falloff;
+                    srcX -= dirX * vacuumPull; // NEGATIVE = sample from further behind
+                    srcY -= dirY * vacuumPull; // NEGATIVE = sample from further behind
+                }
+            }
+        }
+        
+        // Add wake trail effect - disturbance behind projectile
+        if (features & FluidSwirlProjectileState::eWake) {
+            // Project point onto wake line
+            Real projOntoWake = startDX * wakeDirX + startDY * wakeDirY;
+            const Real wakeLength = (Real)s.wakeLength;
+            
+            if (projOntoWake > 0 && projOntoWake < wakeLength) {
+                taken |= 1u << 6;
+                Real closestX = (Real)_projectileStartX + projOntoWake * wakeDirX;
+                Real closestY = (Real)_projectileStartY + projOntoWake * wakeDirY;
+                
+                Real distToWake = std::sqrt((x - closestX) * (x - closestX) + (y - closestY) * (y - closestY));
+                Real ageOfWake = Real(1.0) - (projOntoWake / wakeLength); // Newer wake is stronger
+                
+                if (((x - closestX) * wakeDirY - (y - closestY) * wakeDirX) < 0) {
+                    taken |= 1u << 7;
+                }
+                
+                if (distToWake < wakeWidth) {
+                    taken |= 1u << 8;
+                    // Wake trail effect - fluid diffusion and streaking
+                    Real wakeStrength = flowStrength * std::exp(-distToWake / (wakeWidth * Real(0.3)));
+                    wakeStrength *= std::exp(-ageOfWake / (Real)_wakeDecayParam);
+                    
+                    // EXTREME longitudinal streaking - drag the image behind projectile
+                    Real baseStreakDistance = wakeStrength * Real(60.0); // 3x stronger base streaking
+                    
+                    // Distance-based streak multiplier - closer to wake = more streaking
+                    Real streakMultiplier = Real(1.0) + (Real(3.0) * std::exp(-distToWake / (wakeWidth * Real(0.2))));
+                    
+                    // Age-based streak boost - newer parts of wake streak more
+                    Real ageBoost = Real(1.0) + (Real(2.0) * ageOfWake); // Newer wake streaks MORE
+                    
+                    Real totalStreakDistance = baseStreakDistance * streakMultiplier * ageBoost;
+                    
+                    // Apply massive directional streaking - REVERSED to follow projectile direction
+                    srcX -= wakeDirX * totalStreakDistance * (Real(1.0) + std::sin(distToWake * Real(0.08)) * Real(0.4)); // NEGATIVE = pull FROM behind
+                    srcY -= wakeDirY * totalStreakDistance * (Real(1.0) + std::cos(distToWake * Real(0.08)) * Real(0.4)); // NEGATIVE = pull FROM behind
+                    
+                    // Add additional "drag" effect - pull pixels FROM behind TO front
+                    Real dragEffect = wakeStrength * Real(25.0) * (Real(1.0) - ageOfWake * Real(0.5));
+                    srcX -= wakeDirX * dragEffect; // NEGATIVE = sample from behind
+                    srcY -= wakeDirY * dragEffect; // NEGATIVE = sample from behind
+                    
+                    // Reduced perpendicular diffusion (focus on longitudinal streaking)
+                    Real perpX = -wakeDirY;
+                    Real perpY = wakeDirX;
+                    Real diffusion = wakeStrength * Real(3.0) * std::sin(projOntoWake * Real(0.05) + distToWake * Real(0.2));
+                    srcX += perpX * diffusion;
+                    srcY += perpY * diffusion;
+                    
+                    // Enhanced turbulent mixing for more chaos
+                    Real turbulence = wakeStrength * Real(12.0);
+                    srcX += std::sin(distToWake * Real(0.4) + projOntoWake * Real(0.08)) * turbulence;
+                    srcY += std::cos(distToWake * Real(0.35) + projOntoWake * Real(0.12)) * turbulence;
+                }
+                
+                // Original wake trail diffusion (but with expanding width)
+                if (distToWake < dynamicWakeWidth) {
+                    taken |= 1u << 9;
+                    Real trailBlurAmount = flowStrength * std::exp(-distToWake / (dynamicWakeWidth * Real(0.4)));
+                    trailBlurAmount *= std::exp(-ageOfWake / (Real)_wakeDecayParam);
+                    
+                    if (trailBlurAmount > wakeBlurAmount) {
+                        taken |= 1u << 10;
+                        wakeBlurAmount = trailBlurAmount;
+                    }
+                }
+            }
+        }
+        
+        // Add concentric ripples around current projectile position
+        if (features & FluidSwirlProjectileState::eImpact) {
+            if (distanceFromProjectile < projectileRadius * Real(2.0)) {
+                taken |= 1u << 11;
+                Real ripplePhase = (distanceFromProjectile / projectileRadius) * Real(M_PI);
+                Real rippleStrength = flowStrength * Real(0.3) * std::sin(ripplePhase);
+                
+                if (rippleStrength > 0 && rippleStrength > wakeBlurAmount * Real(0.5)) {
+                    taken |= 1u << 12;
+                    wakeBlurAmount = std::max(wakeBlurAmount, rippleStrength);
+                }
+            }
+        }
+        
+        if (branches) {
+            *branches = taken;
+        }
+    }
+    
+    
+    // Moves pixel coordinate v along one axis into the frame [frame1, frame2) by the edge mode
+    // and then onto the fetched pixels [src1, src2). False where the edge mode is transparent.
+    bool getEdgeCoordinate(int &v, int frame1, int frame2, int src1, int src2) const
+    {
+        if (v < frame1 || v >= frame2) {
+            const int size = frame2 - frame1;
+            int r;
+            switch (_edgeMode) {
+                case eEdgeMirror:
+                    // period 2 size, the edge pixels repeat at the turns
+                    r = (v - frame1) % (2 * size);
+                    r += r < 0 ? 2 * size : 0;
+                    v = frame1 + (r < size ? r : 2 * size - 1 - r);
+                    break;
+                case eEdgeWrap:
+                    r = (v - frame1) % size;
+                    v = frame1 + r + (r < 0 ? size : 0);
+                    break;
+                case eEdgeTransparent:
+                    return false;
+                case eEdgeClamp:
+                    break;
+            }
+        }
+        v = std::max(src1, std::min(src2 - 1, v));
+        return true;
+    }
+    
+    // getEdgeCoordinate for a position between pixel centres, where mirroring reflects about
+    // the frame edge, without the clamp to the fetched pixels. False once a transparent edge
+    // leaves nothing of the frame within a pixel.
+    template <class Real>
+    bool getEdgePosition(Real &v, int frame1, int frame2) const
+    {
+        if (v >= frame1 && v <= frame2 - 1) {
+            return true;
+        }
+        const Real edge = frame1 - Real(0.5);
+        const Real size = (Real)(frame2 - frame1);
+        Real r;
+        switch (_edgeMode) {
+            case eEdgeMirror:
+                r = v - edge - 2 * size * std::floor((v - edge) / (2 * size));
+                v = edge + (r < size ? r : 2 * size - r);
+                break;
+            case eEdgeWrap:
+                v = edge + (v - edge - size * std::floor((v - edge) / size));
+                break;
+            case eEdgeTransparent:
+                return v > frame1 - 1 && v < frame2;
+            case eEdgeClamp:
+                v = std::max((Real)frame1, std::min((Real)(frame2 - 1), v));
+                break;
+        }
+        return true;
+    }
+};
+
+// Bilinear interpolation of one pixel from its four neighbours, fx and fy in [0, 1]. Float
+// pixels interpolate in the compute precision Real. The integer formats round the weights to
+// fixed point (8 fractional bits for 8-bit pixels, 16 for 16-bit ones), interpolate each row
+// in 32 bits, and round the result to nearest. The weights sum to one, so nothing can overflow.
+template <int nComponents, class Real>
+inline void bilinearPixel(const float *p00, const float *p10, const float *p01, const float *p11,
+                          Real fx, Real fy, float *dstPix)
+{
+    const Real fx1 = 1 - fx;
+    const Real fy1 = 1 - fy;
+    for (int c = 0; c < nComponents; c++) {
+        Real interpolated = p00[c] * fx1 * fy1 +
+                              p10[c] * fx * fy1 +
+                              p01[c] * fx1 * fy +
+                              p11[c] * fx * fy;
+        dstPix[c] = (float)interpolated;
+    }
+}
+
+template <int nComponents, class Real>
+inline void bilinearPixel(const unsigned char *p00, const unsigned char *p10, const unsigned char *p01, const unsigned char *p11,
+                          Real fx, Real fy, unsigned char *dstPix)
+{
+    const unsigned int one = 1u << 8;
+    const unsigned int wx = (unsigned int)(fx * one + Real(0.5));
+    const unsigned int wy = (unsigned int)(fy * one + Real(0.5));
+    for (int c = 0; c < nComponents; c++) {
+        const unsigned int top = p00[c] * (one - wx) + p10[c] * wx;
+        const unsigned int bottom = p01[c] * (one - wx) + p11[c] * wx;
+        dstPix[c] = (unsigned char)((top * (one - wy) + bottom * wy + (1u << 15)) >> 16);
+    }
+}
+
+template <int nComponents, class Real>
+inline void bilinearPixel(const unsigned short *p00, const unsigned short *p10, const unsigned short *p01, const unsigned short *p11,
+                          Real fx, Real fy, unsigned short *dstPix)
+{
+    const unsigned int one = 1u << 16;
+    const unsigned int wx = (unsigned int)(fx * one + Real(0.5));
+    const unsigned int wy = (unsigned int)(fy * one + Real(0.5));
+    for (int c = 0; c < nComponents; c++) {
+        // at most 65535 * 65536, which still fits
+        const unsigned int top = p00[c] * (one - wx) + p10[c] * wx;
+        const unsigned int bottom = p01[c] * (one - wx) + p11[c] * wx;
+        const unsigned long long sum = (unsigned long long)top * (one - wy) + (unsigned long long)bottom * wy;
+        dstPix[c] = (unsigned short)((sum + (1ull << 31)) >> 32);
+    }
+}
+
+// Pixel type of the vector bilinear row kernels, see FluidSwirlSIMD::getBilinearRow (the
+// half one is in FluidSwirlHalf.hpp)
+inline FluidSwirlSIMD::PixelType getPixelType(const unsigned char *) { return FluidSwirlSIMD::ePixelUByte; }
+inline FluidSwirlSIMD::PixelType getPixelType(const unsigned short *) { return FluidSwirlSIMD::ePixelUShort; }
+inline FluidSwirlSIMD::PixelType getPixelType(const float *) { return FluidSwirlSIMD::ePixelFloat; }
+
+// Bilinear sample of one pixel as Real values, for taps that are blended further (the wake
+// diffusion), so with the plain weights and without any rounding
+template <int nComponents, class PIX, class Real>
+inline void bilinearSample(const PIX *p00, const PIX *p10, const PIX *p01, const PIX *p11,
+                           Real fx, Real fy, Real *values)
+{
+    const Real fx1 = 1 - fx;
+    const Real fy1 = 1 - fy;
+    for (int c = 0; c < nComponents; c++) {
+        values[c] = p00[c] * fx1 * fy1 +
+                    p10[c] * fx * fy1 +
+                    p01[c] * fx1 * fy +
+                    p11[c] * fx * fy;
+    }
+}
+
+// One kernel per pixel format and flow mode (27 instantiations, plus the half float ones in
+// FluidSwirlHalf.cpp), so neither pass tests the flow mode per pixel.
+template <class PIX, int nComponents, int maxValue, int flowMode>
+class FluidSwirlKernel : public FluidSwirlKernelBase
+{
+public:
+    // Pass 1 maps every pixel of the tile to its source position and wake blur amount, pass 2
+    // resamples the source at those positions. Keeping the two apart leaves the displacement
+    // maths and the pixel fetches each in a short loop of their own, and the resampler is the
+    // same for every flow mode.
+    virtual void processTile(const OfxRectI &procWindow)
+    {
+        const int width = procWindow.x2 - procWindow.x1;
+        const int height = procWindow.y2 - procWindow.y1;
+        
+        // Each row is split into the span the flow mode can displace and the pixels around
+        // it, which are copied when the source holds them (inside the frame and fetched)
+        const OfxRectI copyable = {
+            std::max(_imageBounds.x1, _srcBounds.x1), std::max(_imageBounds.y1, _srcBounds.y1),
+            std::min(_imageBounds.x2, _srcBounds.x2), std::min(_imageBounds.y2, _srcBounds.y2)
+        };
+        const bool copyColumns = procWindow.x1 >= copyable.x1 && procWindow.x2 <= copyable.x2;
+        std::vector<int> spans(2 * height);
+        for (int y = procWindow.y1; y < procWindow.y2; y++) {
+            int &a1 = spans[2 * (y - procWindow.y1)];
+            int &a2 = spans[2 * (y - procWindow.y1) + 1];
+            if (copyColumns && y >= copyable.y1 && y < copyable.y2) {
+                getActiveSpan<flowMode>(y, procWindow.x1, procWindow.x2, a1, a2);
+            } else {
+                a1 = procWindow.x1;
+                a2 = procWindow.x2;
+            }
+        }
+        
+        // Pass 1: coordinates of the active spans, straight from the displacement cache
+        // when it is ready. The adaptive grid computes them for the block around all spans.
+        std::vector<float> scratchOffsets;
+        std::vector<float> scratchBlur;
+        if (!_field) {
+            scratchOffsets.resize(2 * width * height);
+            scratchBlur.resize(flowMode == 2 ? width * height : 0);
+        }
+        
+        const bool useGrid = getGridCellSize() > 1 && !(_field && _fieldReady);
+        OfxRectI block = { procWindow.x2, procWindow.y2, procWindow.x1, procWindow.y1 };
+        std::vector<const float *> rowOffsets(height);
+        std::vector<const float *> rowBlur(height);
+        for (int y = procWindow.y1; y < procWindow.y2; y++) {
+            const int row = y - procWindow.y1;
+            const int a1 = spans[2 * row], a2 = spans[2 * row + 1];
+            if (a1 < a2) {
+                const int index = width * row + (a1 - procWindow.x1);
+                float *scratchRowOffsets = scratchOffsets.empty() ? NULL : &scratchOffsets[2 * index];
+                float *scratchRowBlur = scratchBlur.empty() ? NULL : &scratchBlur[index];
+                if (useGrid) {
+                    float *offsets, *wakeBlur;
+                    getSourceRowStorage<flowMode>(y, a1, scratchRowOffsets, scratchRowBlur, offsets, wakeBlur);
+                    rowOffsets[row] = offsets;
+                    rowBlur[row] = wakeBlur;
+                    block.x1 = std::min(block.x1, a1);
+                    block.x2 = std::max(block.x2, a2);
+                    block.y1 = std::min(block.y1, y);
+                    block.y2 = y + 1;
+                } else {
+                    getSourceRow<flowMode>(y, a1, a2, scratchRowOffsets, scratchRowBlur, rowOffsets[row], rowBlur[row]);
+                }
+            }
+        }
+        
+        if (block.x1 < block.x2) {
+            std::vector<float *> blockOffsets(block.y2 - block.y1);
+            std::vector<float *> blockBlur(block.y2 - block.y1);
+            for (int y = block.y1; y < block.y2; y++) {
+                const int index = width * (y - procWindow.y1) + (block.x1 - procWindow.x1);
+                getSourceRowStorage<flowMode>(y, block.x1,
+                                   scratchOffsets.empty() ? NULL : &scratchOffsets[2 * index],
+                                   scratchBlur.empty() ? NULL : &scratchBlur[index],
+                                   blockOffsets[y - block.y1], blockBlur[y - block.y1]);
+            }
+            computeSourceBlock<flowMode>(block, &blockOffsets[0], &blockBlur[0]);
+        }
+        
+        // Antialiasing also needs the source positions one pixel to the right of and one row
+        // below every active pixel. Inside the tile they come from pass 1, the column right of
+        // and the row below the tile are computed here as that tile computes them, and pixels
+        // outside the active spans pass the source through (no offset).
+        std::vector<float> belowOffsets, rightOffsets;
+        if (_antialiasing) {
+            belowOffsets.assign(2 * width * height, 0.0f);
+            rightOffsets.assign(2 * height, 0.0f);
+            std::vector<float> scratchRowBlur(flowMode == 2 ? width : 0);
+            float *neighbourBlur = scratchRowBlur.empty() ? NULL : &scratchRowBlur[0];
+            for (int row = 0; row < height; row++) {
+                const int y = procWindow.y1 + row;
+                const int a1 = spans[2 * row], a2 = spans[2 * row + 1];
+                if (a1 >= a2) {
+                    continue;
+                }
+                float *below = &belowOffsets[2 * (width * row + (a1 - procWindow.x1))];
+                if (row + 1 < height) {
+                    const int b1 = std::max(a1, spans[2 * row + 2]), b2 = std::min(a2, spans[2 * row + 3]);
+                    if (b1 < b2) {
+                        memcpy(below + 2 * (b1 - a1), rowOffsets[row + 1] + 2 * (b1 - spans[2 * row + 2]), 2 * (b2 - b1) * sizeof(float));
+                    }
+                } else {
+                    int b1, b2;
+                    getActiveSpan<flowMode>(y + 1, a1, a2, b1, b2);
+                    if (b1 < b2) {
+                        computeNeighbourRow<flowMode>(y + 1, b1, b2, below + 2 * (b1 - a1), neighbourBlur);
+                    }
+                }
+                if (a2 == procWindow.x2) {
+                    int b1, b2;
+                    getActiveSpan<flowMode>(y, a2, a2 + 1, b1, b2);
+                    if (b1 < b2) {
+                        computeNeighbourRow<flowMode>(y, a2, a2 + 1, &rightOffsets[2 * row], neighbourBlur);
+                    }
+                }
+            }
+        }
+        
+        // Pass 2: copies and resampling. The vector bilinear row kernels compute in float and
+        // index the source with ints; antialiasing sends nearly every displaced pixel to the
+        // pyramid (anything stretched at all), which leaves them nothing to do.
+        const size_t pixelBytes = nComponents * sizeof(PIX);
+        const bool singlePrecision = useSinglePrecision();
+        const bool fetched2x2 = _srcBounds.x2 - _srcBounds.x1 > 1 && _srcBounds.y2 - _srcBounds.y1 > 1;
+        const bool clampPositions = _edgeMode == eEdgeClamp && fetched2x2;
+        FluidSwirlSIMD::BilinearRowFunc bilinearRow = NULL;
+        if (_useBilinearRow && !_antialiasing && singlePrecision && fetched2x2 &&
+            (double)std::abs((double)_src.getRowBytes()) * (_srcBounds.y2 - _srcBounds.y1) < 2147483647.0) {
+            bilinearRow = FluidSwirlSIMD::getBilinearRow(getPixelType((const PIX *) NULL), nComponents);
+        }
+        std::vector<int> runScratch(bilinearRow ? 3 * width : 0);
+        for (int y = procWindow.y1; y < procWindow.y2; y++) {
+            const int row = y - procWindow.y1;
+            const int a1 = spans[2 * row], a2 = spans[2 * row + 1];
+            if (a1 > procWindow.x1) {
+                memcpy(_dst.getPixelAddress(procWindow.x1, y), _src.getPixelAddress(procWindow.x1, y),
+                       (a1 - procWindow.x1) * pixelBytes);
+            }
+            if (a1 < a2) {
+                PIX *dstPix = (PIX *) _dst.getPixelAddress(a1, y);
+                const float *below = belowOffsets.empty() ? NULL : &belowOffsets[2 * (width * row + (a1 - procWindow.x1))];
+                const float *right = rightOffsets.empty() ? NULL : &rightOffsets[2 * row];
+                int *scratch = runScratch.empty() ? NULL : &runScratch[0];
+                if (singlePrecision) {
+                    if (clampPositions) {
+                        resampleRow<true, float>(y, a1, a2, rowOffsets[row], rowBlur[row], below, right, bilinearRow, scratch, dstPix);
+                    } else {
+                        resampleRow<false, float>(y, a1, a2, rowOffsets[row], rowBlur[row], below, right, bilinearRow, scratch, dstPix);
+                    }
+                } else if (clampPositions) {
+                    resampleRow<true, double>(y, a1, a2, rowOffsets[row], rowBlur[row], below, right, NULL, NULL, dstPix);
+                } else {
+                    resampleRow<false, double>(y, a1, a2, rowOffsets[row], rowBlur[row], below, right, NULL, NULL, dstPix);
+                }
+            }
+            if (a2 < procWindow.x2) {
+                const int x = std::max(a1, a2);
+                memcpy(_dst.getPixelAddress(x, y), _src.getPixelAddress(x, y), (procWindow.x2 - x) * pixelBytes);
+            }
+        }
+    }
+    
+private:
+    // The source pyramid for this render, built by the first pixel that needs it while any
+    // other thread that needs it waits
+    const FluidSwirlMipPyramid &getSourcePyramid()
+    {
+        if (!_sourcePyramidReady.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(_sourcePyramidMutex);
+            if (!_sourcePyramidReady.load(std::memory_order_relaxed)) {
+                _sourcePyramid.build<PIX, nComponents>(_src, _sourcePyramidRegion, _sourcePyramidLevels);
+                _sourcePyramidReady.store(true, std::memory_order_release);
+            }
+        }
+        return _sourcePyramid;
+    }
+    
+    // Writes pixels x1..x2-1 of row y from the source positions x + offsets[2i], y + offsets[2i + 1].
+    // In flow mode 2 pixels with a wake blur amount are averaged over their blur box (wakeBlur
+    // is not read in the other modes), and with belowOffsets (the offsets of the row below,
+    // rightOffset those of pixel x2) pixels whose neighbours' source positions lie more than a
+    // pixel apart are averaged over that distance; both from the source pyramid. Everything
+    // else is a single bilinear tap. Taps that leave the fetched pixels are redirected by
+    // getEdgeTaps, so every pixel takes the same path. With clampPositions (the clamp edge
+    // mode, at least 2 x 2 fetched pixels) the positions are clamped to the fetched pixels
+    // instead, which reads the same values without any test. Positions and weights are
+    // computed in Real.
+    //
+    // With bilinearRow (a vector kernel, for float positions) the plain taps go through
+    // resampleRuns first and only the pixels it leaves are resampled here; scratch holds
+    // 3 * (x2 - x1) ints for it.
+    template <bool clampPositions, class Real>
+    void resampleRow(int y, int x1, int x2, const float *offsets, const float *wakeBlur,
+                     const float *belowOffsets, const float *rightOffset,
+                     FluidSwirlSIMD::BilinearRowFunc bilinearRow, int *scratch, PIX *dstPix)
+    {
+        // Per tile copies: the source layout is copied too, as stores through an 8-bit dstPix
+        // could otherwise alias the members and force reloads for every tap.
+        const OfxRectI srcBounds = _srcBounds;
+        const OFX::ConstImageView src = _src;
+        const ptrdiff_t srcRowBytes = src.getRowBytes();
+        
+        const bool usePyramid = _sourcePyramidLevels > 0;
+        const FluidSwirlMipPyramid *pyramid = NULL;
+        PIX transparent[nComponents];
+        std::fill(transparent, transparent + nComponents, PIX(0.0f));
+        
+        const int *pixels = NULL;
+        int count = x2 - x1;
+        if (bilinearRow) {
+            count = resampleRuns<clampPositions, Real>(bilinearRow, y, x1, x2, offsets, wakeBlur, belowOffsets, rightOffset,
+                                                       scratch, dstPix);
+            pixels = scratch;
+        }
+        
+        for (int k = 0; k < count; k++) {
+            const int i = pixels ? pixels[k] : k;
+            const int x = x1 + i;
+            Real srcX = (Real)x + offsets[2 * i];
+            Real srcY = (Real)y + offsets[2 * i + 1];
+            
+            if (clampPositions) {
+                srcX = std::max((Real)srcBounds.x1, std::min((Real)(srcBounds.x2 - 1), srcX));
+                srcY = std::max((Real)srcBounds.y1, std::min((Real)(srcBounds.y2 - 1), srcY));
+            }
+            int srcXInt = (int)std::floor(srcX);
+            int srcYInt = (int)std::floor(srcY);
+            if (clampPositions) {
+                // the last column and row are the right and bottom taps of a full weight
+                srcXInt = std::min(srcXInt, srcBounds.x2 - 2);
+                srcYInt = std::min(srcYInt, srcBounds.y2 - 2);
+            }
+            Real fx = srcX - srcXInt;
+            Real fy = srcY - srcYInt;
+            
+            // The four surrounding pixels (OFX images are packed, so the neighbours are one
+            // pixel and one row away), or their edge mode stand-ins
+            const PIX *p00, *p10, *p01, *p11;
+            if (clampPositions ||
+                (srcXInt >= srcBounds.x1 && srcXInt < srcBounds.x2 - 1 &&
+                 srcYInt >= srcBounds.y1 && srcYInt < srcBounds.y2 - 1)) {
+                p00 = (const PIX *) src.getRowAddress(srcYInt) + (ptrdiff_t)(srcXInt - src.getBounds().x1) * nComponents;
+                p10 = p00 + nComponents;
+                p01 = (const PIX *) ((const char *) p00 + srcRowBytes);
+                p11 = p01 + nComponents;
+            } else {
+                getEdgeTaps(srcXInt, srcYInt, transparent, p00, p10, p01, p11);
+            }
+            
+            Real lod = usePyramid ? getLevelOfDetail<Real>(i, x2 - x1, offsets, wakeBlur, belowOffsets, rightOffset) : 0;
+            
+            // Trilinear fetch between the pyramid levels around it, where level 0 is the
+            // plain bilinear tap
+            PIX *pix = dstPix + i * nComponents;
+            if (lod > 0) {
+                if (!pyramid) {
+                    pyramid = &getSourcePyramid();
+                }
+                lod = std::min(lod, (Real)pyramid->getLevelCount());
+                const int level = (int)lod;
+                const Real t = lod - level;
+                const bool inFrame = getEdgePosition(srcX, _imageBounds.x1, _imageBounds.x2) &&
+                                     getEdgePosition(srcY, _imageBounds.y1, _imageBounds.y2);
+                
+                Real filtered[4], coarser[4];
+                if (level == 0) {
+                    bilinearSample<nComponents>(p00, p10, p01, p11, fx, fy, filtered);
+                } else {
+                    samplePyramid(*pyramid, level, inFrame, srcX, srcY, filtered);
+                }
+                if (t > 0) {
+                    samplePyramid(*pyramid, level + 1, inFrame, srcX, srcY, coarser);
+                    for (int c = 0; c < nComponents; c++) {
+                        filtered[c] += t * (coarser[c] - filtered[c]);
+                    }
+                }
+                // integer formats round to nearest like the bilinear taps
+                for (int c = 0; c < nComponents; c++) {
+                    pix[c] = (PIX)(maxValue > 1 ? filtered[c] + Real(0.5) : filtered[c]);
+                }
+            } else {
+                bilinearPixel<nComponents>(p00, p10, p01, p11, fx, fy, pix);
+            }
+        }
+    }
+    
+    // Level of detail of pixel i of the n in resampleRow: log2 of the blur box width, or of
+    // the distance between the source positions of neighbouring pixels where that is larger
+    template <class Real>
+    static Real getLevelOfDetail(int i, int n, const float *offsets, const float *wakeBlur,
+                                 const float *belowOffsets, const float *rightOffset)
+    {
+        const Real blurBoxWidth = (Real)kWakeBlurBoxWidth;
+        Real lod = 0;
+        if (flowMode == 2 && wakeBlur[i] * blurBoxWidth > 1) {
+            lod = std::log2(wakeBlur[i] * blurBoxWidth);
+        }
+        if (belowOffsets) {
+            const Real footprint = getFootprint<Real>(i, n, offsets, belowOffsets, rightOffset);
+            if (footprint > 1) {
+                lod = std::max(lod, Real(0.5) * std::log2(footprint));
+            }
+        }
+        return lod;
+    }
+    
+    // Whether getLevelOfDetail is above 0, without the logarithms
+    template <class Real>
+    static bool usesPyramid(int i, int n, const float *offsets, const float *wakeBlur,
+                            const float *belowOffsets, const float *rightOffset)
+    {
+        return (flowMode == 2 && wakeBlur[i] * (Real)kWakeBlurBoxWidth > 1) ||
+               (belowOffsets && getFootprint<Real>(i, n, offsets, belowOffsets, rightOffset) > 1);
+    }
+    
+    // Squared distance between the source position of pixel i and those of its right and
+    // lower neighbours, whichever is larger
+    template <class Real>
+    static Real getFootprint(int i, int n, const float *offsets, const float *belowOffsets, const float *rightOffset)
+    {
+        const float *next = i + 1 < n ? &offsets[2 * i + 2] : rightOffset;
+        const Real dxX = 1 + (Real)next[0] - offsets[2 * i];
+        const Real dxY = (Real)next[1] - offsets[2 * i + 1];
+        const Real dyX = (Real)belowOffsets[2 * i] - offsets[2 * i];
+        const Real dyY = 1 + (Real)belowOffsets[2 * i + 1] - offsets[2 * i + 1];
+        return std::max(dxX * dxX + dxY * dxY, dyX * dyX + dyY * dyY);
+    }
+    
+    // The plain bilinear taps of resampleRow through bilinearRow: the runs between the pyramid
+    // fetches, with the positions clamped to the fetched pixels. Returns how many pixels are
+    // left for resampleRow and lists them in ascending order at the start of scratch (3 ints
+    // per pixel): the pyramid fetches, runs too short to fill a vector, and outside the clamp
+    // edge mode the taps that reached past the fetched pixels.
+    static const int kMinBilinearRun = 8;
+    
+    template <bool clampPositions, class Real>
+    int resampleRuns(FluidSwirlSIMD::BilinearRowFunc bilinearRow, int y, int x1, int x2, const float *offsets,
+                     const float *wakeBlur, const float *belowOffsets, const float *rightOffset,
+                     int *scratch, PIX *dstPix)
+    {
+        const int n = x2 - x1;
+        int *left = scratch;
+        int *pyramidPixels = scratch + n;
+        int *edgePixels = scratch + 2 * n;
+        int nPyramidPixels = 0;
+        if (_sourcePyramidLevels > 0) {
+            for (int i = 0; i < n; i++) {
+                if (usesPyramid<Real>(i, n, offsets, wakeBlur, belowOffsets, rightOffset)) {
+                    pyramidPixels[nPyramidPixels++] = i;
+                }
+            }
+        }
+        
+        const FluidSwirlSIMD::BilinearSource source = {
+            _src.getPixelAddress(_srcBounds.x1, _srcBounds.y1), _src.getRowBytes(),
+            _srcBounds.x1, _srcBounds.y1, _srcBounds.x2, _srcBounds.y2
+        };
+        int nLeft = 0;
+        int runStart = 0;
+        for (int j = 0; j <= nPyramidPixels; j++) {
+            const int runEnd = j < nPyramidPixels ? pyramidPixels[j] : n;
+            if (runEnd - runStart < kMinBilinearRun) {
+                for (int i = runStart; i < runEnd; i++) {
+                    left[nLeft++] = i;
+                }
+            } else {
+                const int nEdgePixels = bilinearRow(source, y, x1 + runStart, x1 + runEnd, offsets + 2 * runStart,
+                                                    dstPix + runStart * nComponents, edgePixels);
+                for (int k = 0; !clampPositions && k < nEdgePixels; k++) {
+                    left[nLeft++] = runStart + edgePixels[k];
+                }
+            }
+            if (j < nPyramidPixels) {
+                left[nLeft++] = runEnd;
+            }
+            runStart = runEnd + 1;
+        }
+        return nLeft;
+    }
+    
+    // The taps around (srcXInt, srcYInt) where they leave the fetched pixels: each one moved
+    // into the frame by the edge mode and then onto the nearest fetched pixel, or the
+    // transparent pixel where the edge mode makes it transparent
+    void getEdgeTaps(int srcXInt, int srcYInt, const PIX *transparent,
+                     const PIX *&p00, const PIX *&p10, const PIX *&p01, const PIX *&p11) const
+    {
+        int x0 = srcXInt, x1 = srcXInt + 1;
+        int y0 = srcYInt, y1 = srcYInt + 1;
+        const bool inX0 = getEdgeCoordinate(x0, _imageBounds.x1, _imageBounds.x2, _srcBounds.x1, _srcBounds.x2);
+        const bool inX1 = getEdgeCoordinate(x1, _imageBounds.x1, _imageBounds.x2, _srcBounds.x1, _srcBounds.x2);
+        const bool inY0 = getEdgeCoordinate(y0, _imageBounds.y1, _imageBounds.y2, _srcBounds.y1, _srcBounds.y2);
+        const bool inY1 = getEdgeCoordinate(y1, _imageBounds.y1, _imageBounds.y2, _srcBounds.y1, _srcBounds.y2);
+        p00 = inX0 && inY0 ? (const PIX *) _src.getPixelAddress(x0, y0) : transparent;
+        p10 = inX1 && inY0 ? (const PIX *) _src.getPixelAddress(x1, y0) : transparent;
+        p01 = inX0 && inY1 ? (const PIX *) _src.getPixelAddress(x0, y1) : transparent;
+        p11 = inX1 && inY1 ? (const PIX *) _src.getPixelAddress(x1, y1) : transparent;
+    }
+    
+    // Pyramid level at the position getEdgePosition moved into the frame, zero outside it
+    template <class Real>
+    static void samplePyramid(const FluidSwirlMipPyramid &pyramid, int level, bool inFrame, Real x, Real y, Real *values)
+    {
+        if (inFrame) {
+            pyramid.sample<nComponents>(level, x, y, values);
+        } else {
+            std::fill(values, values + nComponents, Real(0));
+        }
+    }
+};
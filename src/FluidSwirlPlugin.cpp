@@ -1,11 +1,14 @@
 #include "ofxsImageEffect.h"
 #include "ofxsMultiThread.h"
+#include "ofxsProcessing.H"
+#include "FluidSwirlKernel.hpp"
+#include "FluidSwirlHalf.hpp"
 #include <cmath>
 #include <algorithm>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #define kPluginName "FluidSwirl"
 #define kPluginGrouping "Filter"
@@ -74,10 +77,39 @@
 #define kParamWakeDecayLabel "Wake Decay"
 #define kParamWakeDecayHint "How quickly the wake trail fades behind projectile"
 
-using namespace OFX;
+#define kParamFiltering "filtering"
+#define kParamFilteringLabel "Filtering"
+#define kParamFilteringHint "How the displaced pixels sample the source. Bilinear reads the 4 nearest source pixels, which aliases (shimmers) where the effect squeezes a large part of the image into a small one. Anti-aliased averages each pixel over the source area it covers, read from a mip pyramid of the source at a constant cost per pixel"
+
+#define kParamEdgeMode "edgeMode"
+#define kParamEdgeModeLabel "Edge Mode"
+#define kParamEdgeModeHint "What the effect finds where it pulls pixels in from beyond the edge of the frame"
+
+#define kGroupAdvanced "advanced"
+#define kGroupAdvancedLabel "Advanced"
+
+#define kParamTileSize "tileSize"
+#define kParamTileSizeLabel "Render Tile Size"
+#define kParamTileSizeHint "Edge length in pixels of the tiles render threads pull from the shared work queue (affects speed only)"
+#define kParamTileSizeDefault 64
 
-// Forward declaration
-class FluidSwirlProcessorBase;
+#define kParamUseSIMD "useSIMD"
+#define kParamUseSIMDLabel "Vector Instructions"
+#define kParamUseSIMDHint "Compute the radial swirl with AVX-512 or AVX2 when the CPU supports them, and from a precomputed rotation table otherwise (within 1/400 pixel of the scalar code). Turn off to compare against the scalar reference"
+
+#define kParamDisplacementGrid "displacementGrid"
+#define kParamDisplacementGridLabel "Displacement Grid"
+#define kParamDisplacementGridHint "Compute the exact displacement for every pixel, or only every 4 or 8 pixels and interpolate in between wherever that stays within 1/20 pixel of the exact value (checked in the middle of every grid cell, other cells are computed per pixel)"
+
+#define kParamComputePrecision "computePrecision"
+#define kParamComputePrecisionLabel "Compute Precision"
+#define kParamComputePrecisionHint "Precision of the displacement maths and the resampling. Automatic uses single precision (float) wherever it keeps positions within 1/1000 pixel, which is every frame smaller than 16384 pixels from the origin, and double precision otherwise and always in Projectile Wake mode, whose hard edges float rounding can move pixels across"
+
+#define kParamCacheDisplacement "cacheDisplacement"
+#define kParamCacheDisplacementLabel "Cache Displacement"
+#define kParamCacheDisplacementHint "Keep the per-pixel displacement between frames and reuse it while the parameters and image size stay the same (uses 8 bytes per pixel, 12 in Projectile Wake mode)"
+
+using namespace OFX;
 
 class FluidSwirlPlugin : public OFX::ImageEffect
 {
@@ -101,6 +133,19 @@ protected:
     OFX::DoubleParam *_projectileSpeed;
     OFX::DoubleParam *_projectileRadius;
     OFX::DoubleParam *_wakeDecay;
+    
+    OFX::ChoiceParam *_filtering;
+    OFX::ChoiceParam *_edgeMode;
+    
+    OFX::IntParam *_tileSize;
+    OFX::BooleanParam *_useSIMD;
+    OFX::ChoiceParam *_displacementGrid;
+    OFX::ChoiceParam *_computePrecision;
+    OFX::BooleanParam *_cacheDisplacement;
+    
+    // Most recently built displacement field, shared with renders that can reuse it
+    std::shared_ptr<FluidSwirlDisplacementField> _displacementField;
+    std::mutex _displacementFieldMutex;
 
 public:
     FluidSwirlPlugin(OfxImageEffectHandle handle) : ImageEffect(handle), _dstClip(0), _srcClip(0)
@@ -125,525 +170,95 @@ public:
         _projectileRadius = fetchDoubleParam(kParamProjectileRadius);
         _wakeDecay = fetchDoubleParam(kParamWakeDecay);
         
+        _filtering = fetchChoiceParam(kParamFiltering);
+        _edgeMode = fetchChoiceParam(kParamEdgeMode);
+        
+        _tileSize = fetchIntParam(kParamTileSize);
+        _useSIMD = fetchBooleanParam(kParamUseSIMD);
+        _displacementGrid = fetchChoiceParam(kParamDisplacementGrid);
+        _computePrecision = fetchChoiceParam(kParamComputePrecision);
+        _cacheDisplacement = fetchBooleanParam(kParamCacheDisplacement);
+        
         assert(_dstClip && _swirlIntensity && _center && _radius && _decay && 
                _flowDirection && _flowStrength && _wakeWidth && _vortexSpacing && _flowMode &&
-               _projectileStart && _projectileEnd && _projectileSpeed && _projectileRadius && _wakeDecay);
+               _projectileStart && _projectileEnd && _projectileSpeed && _projectileRadius && _wakeDecay &&
+               _filtering && _edgeMode && _tileSize && _useSIMD && _displacementGrid && _computePrecision && _cacheDisplacement);
     }
 
 private:
     template <class PIX, int nComponents, int maxValue>
     void renderInternal(const OFX::RenderArguments &args,
                        OFX::BitDepthEnum bitDepth);
+    void renderHalf(const OFX::RenderArguments &args, int nComponents);
 
-    void setupAndProcess(FluidSwirlProcessorBase &processor,
+    void setupAndProcess(FluidSwirlKernelBase &kernel,
                         const OFX::RenderArguments &args);
 
+    OfxRectD getSourcePixelRoD(double time, const OfxPointD &renderScale);
+    void getPixelParams(double time, const OfxRectD &frame, FluidSwirlParams &params);
+
 public:
     virtual void render(const OFX::RenderArguments &args);
     virtual bool isIdentity(const OFX::IsIdentityArguments &args, OFX::Clip * &identityClip, double &identityTime);
     virtual void changedParam(const OFX::InstanceChangedArgs &args, const std::string &paramName);
     virtual void getClipPreferences(OFX::ClipPreferencesSetter &clipPreferences);
     virtual bool getRegionOfDefinition(const OFX::RegionOfDefinitionArguments &args, OfxRectD &rod);
+    virtual void getRegionsOfInterest(const OFX::RegionsOfInterestArguments &args, OFX::RegionOfInterestSetter &rois);
 };
 
-class FluidSwirlProcessorBase
+// Runs a kernel over the render window on the host's threads. The window is cut into
+// _tileSize x _tileSize tiles which threads claim in order through _nextTile until the
+// queue is drained.
+class FluidSwirlProcessor : public OFX::ImageProcessor
 {
-protected:
-    double _swirlIntensity;
-    double _centerX, _centerY;
-    double _radius;
-    double _decay;
-    double _flowDirection;
-    double _flowStrength;
-    double _wakeWidth;
-    double _vortexSpacing;
-    int _flowMode;
-    
-    // Projectile parameters
-    double _projectileStartX, _projectileStartY;
-    double _projectileEndX, _projectileEndY;
-    double _projectileSpeed;
-    double _projectileRadius;
-    double _wakeDecayParam;
-    double _currentTime;
-    
-    OFX::ImageEffect &_effect;
-    const OFX::Image *_srcImg;
-    OFX::Image *_dstImg;
-    OfxRectI _renderWindow;
+    FluidSwirlKernelBase &_kernel;
+    int _tileSize;
+    int _tilesX, _tilesY;
+    std::atomic<int> _nextTile;
 
 public:
-    FluidSwirlProcessorBase(OFX::ImageEffect &instance) : _effect(instance), _srcImg(0), _dstImg(0) {}
+    FluidSwirlProcessor(OFX::ImageEffect &instance, FluidSwirlKernelBase &kernel)
+        : OFX::ImageProcessor(instance), _kernel(kernel), _tileSize(kParamTileSizeDefault), _tilesX(0), _tilesY(0), _nextTile(0) {}
     
-    void setDstImg(OFX::Image *v) { _dstImg = v; }
-    void setSrcImg(const OFX::Image *v) { _srcImg = v; }
-    void setRenderWindow(OfxRectI rect) { _renderWindow = rect; }
-    void process() { multiThreadProcessImages(_renderWindow); }
+    void setTileSize(int v) { _tileSize = std::max(8, v); }
     
-    void setSwirlParams(double intensity, double centerX, double centerY, double radius, double decay,
-                       double flowDirection, double flowStrength, double wakeWidth, double vortexSpacing, int flowMode,
-                       double projStartX, double projStartY, double projEndX, double projEndY, 
-                       double projSpeed, double projRadius, double wakeDecay, double currentTime)
+    // overridden from OFX::ImageProcessor, builds the tile queue before threads start
+    virtual void preProcess()
     {
-        _swirlIntensity = intensity;
-        _centerX = centerX;
-        _centerY = centerY;
-        _radius = radius;
-        _decay = decay;
-        _flowDirection = flowDirection;
-        _flowStrength = flowStrength;
-        _wakeWidth = wakeWidth;
-        _vortexSpacing = vortexSpacing;
-        _flowMode = flowMode;
-        
-        // Projectile parameters
-        _projectileStartX = projStartX;
-        _projectileStartY = projStartY;
-        _projectileEndX = projEndX;
-        _projectileEndY = projEndY;
-        _projectileSpeed = projSpeed;
-        _projectileRadius = projRadius;
-        _wakeDecayParam = wakeDecay;
-        _currentTime = currentTime;
-    }
-    
-protected:
-    virtual void multiThreadProcessImages(OfxRectI procWindow) = 0;
-    
-    void* getDstPixelAddress(int x, int y) {
-        return _dstImg->getPixelAddress(x, y);
+        _tilesX = (_renderWindow.x2 - _renderWindow.x1 + _tileSize - 1) / _tileSize;
+        _tilesY = (_renderWindow.y2 - _renderWindow.y1 + _tileSize - 1) / _tileSize;
+        _nextTile.store(0);
     }
     
-    const void* getSrcPixelAddress(int x, int y) {
-        return _srcImg->getPixelAddress(x, y);
-    }
-};
-
-template <class PIX, int nComponents, int maxValue>
-class FluidSwirlProcessor : public FluidSwirlProcessorBase
-{
-public:
-    FluidSwirlProcessor(OFX::ImageEffect &instance) : FluidSwirlProcessorBase(instance) {}
-
-private:
-    void multiThreadProcessImages(OfxRectI procWindow)
+    // overridden from OFX::ImageProcessor. Instead of one fixed band of rows per thread,
+    // every thread keeps taking the next free tile, so threads that land on cheap tiles
+    // (outside the wake, say) simply process more of them.
+    virtual void multiThreadFunction(unsigned int /*threadId*/, unsigned int /*nThreads*/)
     {
-        const int width = procWindow.x2 - procWindow.x1;
-        const int height = procWindow.y2 - procWindow.y1;
+        const int nTiles = _tilesX * _tilesY;
         
-        // Convert flow direction to radians
-        const double flowDirRad = _flowDirection * M_PI / 180.0;
-        const double flowCos = cos(flowDirRad);
-        const double flowSin = sin(flowDirRad);
-        
-        for (int y = procWindow.y1; y < procWindow.y2; y++) {
-            if (_effect.abort()) break;
+        for (;;) {
+            const int tile = _nextTile.fetch_add(1, std::memory_order_relaxed);
+            if (tile >= nTiles || _effect.abort()) {
+                break;
+            }
             
-            PIX *dstPix = (PIX *) getDstPixelAddress(procWindow.x1, y);
+            OfxRectI tileWindow;
+            tileWindow.x1 = _renderWindow.x1 + (tile % _tilesX) * _tileSize;
+            tileWindow.y1 = _renderWindow.y1 + (tile / _tilesX) * _tileSize;
+            tileWindow.x2 = std::min(tileWindow.x1 + _tileSize, _renderWindow.x2);
+            tileWindow.y2 = std::min(tileWindow.y1 + _tileSize, _renderWindow.y2);
             
-            for (int x = procWindow.x1; x < procWindow.x2; x++) {
-                double srcX = x;
-                double srcY = y;
-                
-                // Check if effect is strong enough to apply
-                bool applyEffect = (fabs(_swirlIntensity) > 0.001 || fabs(_flowStrength) > 0.001);
-                
-                if (applyEffect && _flowMode == 0) {
-                    // Original radial swirl
-                    double dx = x - _centerX;
-                    double dy = y - _centerY;
-                    double distance = sqrt(dx * dx + dy * dy);
-                    
-                    double angle = atan2(dy, dx);
-                    double swirlAngle = 0.0;
-                    if (_decay > 0.001) {
-                        swirlAngle = _swirlIntensity * exp(-distance / _decay);
-                    }
-                    angle += swirlAngle;
-                    
-                    srcX = _centerX + distance * cos(angle);
-                    srcY = _centerY + distance * sin(angle);
-                    
-                } else if (applyEffect && _flowMode == 1) {
-                    // Directional flow
-                    double dx = x - _centerX;
-                    double dy = y - _centerY;
-                    
-                    // Distance from flow line (perpendicular distance)
-                    double perpDist = fabs(dx * flowSin - dy * flowCos);
-                    double flowEffect = 0.0;
-                    if (_wakeWidth > 0.001) {
-                        flowEffect = _flowStrength * exp(-perpDist / _wakeWidth);
-                    }
-                    
-                    // Apply flow displacement
-                    srcX = x - flowEffect * flowCos;
-                    srcY = y - flowEffect * flowSin;
-                    
-                } else if (applyEffect && _flowMode == 2) {
-                    // Projectile Wake Effect - like a bullet flying through fluid with expanding waves
-                    
-                    // Calculate projectile position based on time
-                    double progress = (_currentTime / _projectileSpeed);
-                    double projectileX = _projectileStartX + progress * (_projectileEndX - _projectileStartX);
-                    double projectileY = _projectileStartY + progress * (_projectileEndY - _projectileStartY);
-                    
-                    // Add expanding wave distortion from start point
-                    double distFromStart = sqrt((x - _projectileStartX) * (x - _projectileStartX) + 
-                                              (y - _projectileStartY) * (y - _projectileStartY));
-                    
-                    double waveRadius = progress * _projectileRadius * 4.0;
-                    double maxWaveRadius = _projectileRadius * 8.0;
-                    waveRadius = std::min(waveRadius, maxWaveRadius);
-                    
-                    // Apply expanding wave distortion
-                    if (distFromStart < waveRadius && waveRadius > 1.0 && distFromStart > 0.1) {
-                        double waveDirection = atan2(y - _projectileStartY, x - _projectileStartX);
-                        double waveStrength = _swirlIntensity * 15.0; // Wave displacement strength
-                        
-                        // Wave front effect - stronger at the edges
-                        double distanceRatio = distFromStart / waveRadius;
-                        double waveFrontEffect = sin(distanceRatio * M_PI) * 2.0; // Peak at middle of wave
-                        
-                        // Time decay
-                        double timeDecay = exp(-progress / (_wakeDecayParam * 2.0));
-                        
-                        double totalWaveDisplacement = waveStrength * waveFrontEffect * timeDecay;
-                        
-                        // Apply radial displacement (outward from start point)
-                        srcX += cos(waveDirection) * totalWaveDisplacement;
-                        srcY += sin(waveDirection) * totalWaveDisplacement;
-                        
-                        // Add some rotational component for more fluid-like motion
-                        double rotationalComponent = totalWaveDisplacement * 0.3;
-                        srcX += -sin(waveDirection) * rotationalComponent * sin(distFromStart * 0.1);
-                        srcY += cos(waveDirection) * rotationalComponent * sin(distFromStart * 0.1);
-                    }
-                    
-                    // Distance from current projectile position
-                    double dx = x - projectileX;
-                    double dy = y - projectileY;
-                    double distanceFromProjectile = sqrt(dx * dx + dy * dy);
-                    
-                    // Calculate displacement field around current projectile position
-                    if (distanceFromProjectile < _projectileRadius && distanceFromProjectile > 0.1) {
-                        // Strong displacement field - pull pixels toward projectile trajectory
-                        double projDirX = _projectileEndX - _projectileStartX;
-                        double projDirY = _projectileEndY - _projectileStartY;
-                        double projDirLength = sqrt(projDirX * projDirX + projDirY * projDirY);
-                        if (projDirLength > 0.001) {
-                            projDirX /= projDirLength;
-                            projDirY /= projDirLength;
-                        }
-                        
-                        // Calculate EXTREME displacement strength for massive pulling effect
-                        double falloff = exp(-distanceFromProjectile / (_projectileRadius * 0.15)); // Tighter falloff
-                        double baseDisplacement = _swirlIntensity * 150.0 * falloff; // Almost 2x stronger
-                        
-                        // Additional "suction" effect - pixels get dragged along more aggressively
-                        double suctionEffect = _swirlIntensity * 50.0 * falloff;
-                        
-                        // Pull pixels STRONGLY in projectile direction
-                        double totalDisplacement = baseDisplacement + suctionEffect;
-                        
-                        // Directional pulling - REVERSED to create forward-flowing streaks
-                        srcX -= projDirX * totalDisplacement; // NEGATIVE = sample from behind projectile
-                        srcY -= projDirY * totalDisplacement; // NEGATIVE = sample from behind projectile
-                        
-                        // Add some perpendicular swirl (but less than before)
-                        double perpX = -projDirY;
-                        double perpY = projDirX;
-                        double perpDist = fabs(dx * perpX + dy * perpY);
-                        double swirlAmount = totalDisplacement * 0.3 * sin(perpDist * 0.08); // Reduced swirl, more drag
-                        
-                        srcX += perpX * swirlAmount;
-                        srcY += perpY * swirlAmount;
-                        
-                        // Additional "vacuum" effect - sample from even further behind for forward streaks
-                        if ((dx * projDirX + dy * projDirY) < 0) { // Behind projectile
-                            double vacuumPull = _swirlIntensity * 30.0 * falloff;
-                            srcX -= projDirX * vacuumPull; // NEGATIVE = sample from further behind
-                            srcY -= projDirY * vacuumPull; // NEGATIVE = sample from further behind
-                        }
-                    }
-                    
-                    // Add wake trail effect - disturbance behind projectile
-                    double wakeStartX = _projectileStartX;
-                    double wakeStartY = _projectileStartY;
-                    double wakeEndX = projectileX;
-                    double wakeEndY = projectileY;
-                    
-                    // Distance to wake trail line
-                    double wakeLength = sqrt((wakeEndX - wakeStartX) * (wakeEndX - wakeStartX) + 
-                                           (wakeEndY - wakeStartY) * (wakeEndY - wakeStartY));
-                    if (wakeLength > 0.001) {
-                        double wakeDirX = (wakeEndX - wakeStartX) / wakeLength;
-                        double wakeDirY = (wakeEndY - wakeStartY) / wakeLength;
-                        
-                        // Project point onto wake line
-                        double projOntoWake = (x - wakeStartX) * wakeDirX + (y - wakeStartY) * wakeDirY;
-                        
-                        if (projOntoWake > 0 && projOntoWake < wakeLength) {
-                            double closestX = wakeStartX + projOntoWake * wakeDirX;
-                            double closestY = wakeStartY + projOntoWake * wakeDirY;
-                            
-                            double distToWake = sqrt((x - closestX) * (x - closestX) + (y - closestY) * (y - closestY));
-                            
-                            if (distToWake < _wakeWidth) {
-                                // Wake trail effect - fluid diffusion and streaking
-                                double wakeStrength = _flowStrength * exp(-distToWake / (_wakeWidth * 0.3));
-                                double ageOfWake = 1.0 - (projOntoWake / wakeLength); // Newer wake is stronger
-                                wakeStrength *= exp(-ageOfWake / _wakeDecayParam);
-                                
-                                // EXTREME longitudinal streaking - drag the image behind projectile
-                                double baseStreakDistance = wakeStrength * 60.0; // 3x stronger base streaking
-                                
-                                // Distance-based streak multiplier - closer to wake = more streaking
-                                double streakMultiplier = 1.0 + (3.0 * exp(-distToWake / (_wakeWidth * 0.2)));
-                                
-                                // Age-based streak boost - newer parts of wake streak more
-                                double ageBoost = 1.0 + (2.0 * ageOfWake); // Newer wake streaks MORE
-                                
-                                double totalStreakDistance = baseStreakDistance * streakMultiplier * ageBoost;
-                                
-                                // Apply massive directional streaking - REVERSED to follow projectile direction
-                                srcX -= wakeDirX * totalStreakDistance * (1.0 + sin(distToWake * 0.08) * 0.4); // NEGATIVE = pull FROM behind
-                                srcY -= wakeDirY * totalStreakDistance * (1.0 + cos(distToWake * 0.08) * 0.4); // NEGATIVE = pull FROM behind
-                                
-                                // Add additional "drag" effect - pull pixels FROM behind TO front
-                                double dragEffect = wakeStrength * 25.0 * (1.0 - ageOfWake * 0.5);
-                                srcX -= wakeDirX * dragEffect; // NEGATIVE = sample from behind
-                                srcY -= wakeDirY * dragEffect; // NEGATIVE = sample from behind
-                                
-                                // Reduced perpendicular diffusion (focus on longitudinal streaking)
-                                double perpX = -wakeDirY;
-                                double perpY = wakeDirX;
-                                double diffusion = wakeStrength * 3.0 * sin(projOntoWake * 0.05 + distToWake * 0.2);
-                                srcX += perpX * diffusion;
-                                srcY += perpY * diffusion;
-                                
-                                // Enhanced turbulent mixing for more chaos
-                                double turbulence = wakeStrength * 12.0;
-                                srcX += sin(distToWake * 0.4 + projOntoWake * 0.08) * turbulence;
-                                srcY += cos(distToWake * 0.35 + projOntoWake * 0.12) * turbulence;
-                            }
-                        }
-                    }
-                }
-                
-                // Determine if we're in a wake-affected area for special sampling
-                bool inWakeArea = false;
-                double wakeBlurAmount = 0.0;
-                
-                // Check if we're in the wake trail for fluid diffusion sampling
-                if (applyEffect && _flowMode == 2) {
-                    double progress = (_currentTime / _projectileSpeed);
-                    double projectileX = _projectileStartX + progress * (_projectileEndX - _projectileStartX);
-                    double projectileY = _projectileStartY + progress * (_projectileEndY - _projectileStartY);
-                    
-                    // Check for expanding wave diffusion from start point
-                    double distFromStart = sqrt((x - _projectileStartX) * (x - _projectileStartX) + 
-                                              (y - _projectileStartY) * (y - _projectileStartY));
-                    
-                    // Wave expansion: starts small and grows over time
-                    double waveRadius = progress * _projectileRadius * 4.0; // Wave expands 4x projectile radius
-                    double maxWaveRadius = _projectileRadius * 8.0; // Maximum expansion
-                    waveRadius = std::min(waveRadius, maxWaveRadius);
-                    
-                    // Check if we're in the expanding wave field
-                    if (distFromStart < waveRadius && waveRadius > 1.0) {
-                        double waveStrength = _flowStrength * 0.5; // Base wave strength
-                        
-                        // Create ripple effect - stronger at wave fronts
-                        double ripplePhase = (distFromStart / waveRadius) * 2.0 * M_PI;
-                        double rippleEffect = (sin(ripplePhase * 3.0) + 1.0) * 0.5; // 0 to 1
-                        
-                        // Distance-based falloff
-                        double waveFalloff = 1.0 - (distFromStart / waveRadius);
-                        waveFalloff = waveFalloff * waveFalloff; // Quadratic falloff
-                        
-                        // Time-based decay
-                        double timeDecay = exp(-progress / _wakeDecayParam);
-                        
-                        double totalWaveStrength = waveStrength * rippleEffect * waveFalloff * timeDecay;
-                        
-                        if (totalWaveStrength > wakeBlurAmount) {
-                            inWakeArea = true;
-                            wakeBlurAmount = totalWaveStrength;
-                        }
-                    }
-                    
-                    // Original wake trail (but with expanding width)
-                    double wakeStartX = _projectileStartX;
-                    double wakeStartY = _projectileStartY;
-                    double wakeEndX = projectileX;
-                    double wakeEndY = projectileY;
-                    
-                    double wakeLength = sqrt((wakeEndX - wakeStartX) * (wakeEndX - wakeStartX) + 
-                                           (wakeEndY - wakeStartY) * (wakeEndY - wakeStartY));
-                    
-                    if (wakeLength > 0.001) {
-                        double wakeDirX = (wakeEndX - wakeStartX) / wakeLength;
-                        double wakeDirY = (wakeEndY - wakeStartY) / wakeLength;
-                        double projOntoWake = (x - wakeStartX) * wakeDirX + (y - wakeStartY) * wakeDirY;
-                        
-                        if (projOntoWake > 0 && projOntoWake < wakeLength) {
-                            double closestX = wakeStartX + projOntoWake * wakeDirX;
-                            double closestY = wakeStartY + projOntoWake * wakeDirY;
-                            double distToWake = sqrt((x - closestX) * (x - closestX) + (y - closestY) * (y - closestY));
-                            
-                            // Wake width expands over time/distance
-                            double dynamicWakeWidth = _wakeWidth * (1.0 + progress * 2.0); // Expands 3x over time
-                            
-                            if (distToWake < dynamicWakeWidth) {
-                                double trailBlurAmount = _flowStrength * exp(-distToWake / (dynamicWakeWidth * 0.4));
-                                double ageOfWake = 1.0 - (projOntoWake / wakeLength);
-                                trailBlurAmount *= exp(-ageOfWake / _wakeDecayParam);
-                                
-                                if (trailBlurAmount > wakeBlurAmount) {
-                                    inWakeArea = true;
-                                    wakeBlurAmount = trailBlurAmount;
-                                }
-                            }
-                        }
-                    }
-                    
-                    // Add concentric ripples around current projectile position
-                    double distFromProjectile = sqrt((x - projectileX) * (x - projectileX) + 
-                                                    (y - projectileY) * (y - projectileY));
-                    
-                    if (distFromProjectile < _projectileRadius * 2.0) {
-                        double ripplePhase = (distFromProjectile / _projectileRadius) * M_PI;
-                        double rippleStrength = _flowStrength * 0.3 * sin(ripplePhase);
-                        
-                        if (rippleStrength > 0 && rippleStrength > wakeBlurAmount * 0.5) {
-                            inWakeArea = true;
-                            wakeBlurAmount = std::max(wakeBlurAmount, rippleStrength);
-                        }
-                    }
-                }
-                
-                // Sample with bilinear interpolation or fluid diffusion
-                int srcXInt = (int)floor(srcX);
-                int srcYInt = (int)floor(srcY);
-                
-                // Get source image bounds
-                OfxRectI srcBounds = _srcImg->getBounds();
-                
-                // Check if we can do bilinear interpolation (need all 4 pixels)
-                if (srcXInt >= srcBounds.x1 && srcXInt < srcBounds.x2-1 && 
-                    srcYInt >= srcBounds.y1 && srcYInt < srcBounds.y2-1) {
-                    
-                    double fx = srcX - srcXInt;
-                    double fy = srcY - srcYInt;
-                    double fx1 = 1.0 - fx;
-                    double fy1 = 1.0 - fy;
-                    
-                    // Get four surrounding pixels
-                    PIX *p00 = (PIX *) getSrcPixelAddress(srcXInt, srcYInt);
-                    PIX *p10 = (PIX *) getSrcPixelAddress(srcXInt + 1, srcYInt);
-                    PIX *p01 = (PIX *) getSrcPixelAddress(srcXInt, srcYInt + 1);
-                    PIX *p11 = (PIX *) getSrcPixelAddress(srcXInt + 1, srcYInt + 1);
-                    
-                    // Use fluid diffusion sampling in wake areas
-                    if (inWakeArea && wakeBlurAmount > 0.01) {
-                        // Multi-sample for fluid diffusion effect
-                        double totalWeight = 0.0;
-                        double sampledColor[4] = {0.0, 0.0, 0.0, 0.0}; // Max 4 components
-                        
-                        // Sample MORE points for EXTREME diffusion and streaking
-                        int numSamples = 8; // More samples for smoother diffusion
-                        double blurRadius = wakeBlurAmount * 6.0; // 2x larger blur radius for more smearing
-                        
-                        for (int s = 0; s < numSamples; s++) {
-                            double angle = (s * 2.0 * M_PI) / numSamples;
-                            double sampleX = srcX + cos(angle) * blurRadius * ((double)s / numSamples);
-                            double sampleY = srcY + sin(angle) * blurRadius * ((double)s / numSamples);
-                            
-                            int sampleXInt = (int)floor(sampleX);
-                            int sampleYInt = (int)floor(sampleY);
-                            
-                            if (sampleXInt >= srcBounds.x1 && sampleXInt < srcBounds.x2-1 && 
-                                sampleYInt >= srcBounds.y1 && sampleYInt < srcBounds.y2-1) {
-                                
-                                double sfx = sampleX - sampleXInt;
-                                double sfy = sampleY - sampleYInt;
-                                double sfx1 = 1.0 - sfx;
-                                double sfy1 = 1.0 - sfy;
-                                
-                                PIX *sp00 = (PIX *) getSrcPixelAddress(sampleXInt, sampleYInt);
-                                PIX *sp10 = (PIX *) getSrcPixelAddress(sampleXInt + 1, sampleYInt);
-                                PIX *sp01 = (PIX *) getSrcPixelAddress(sampleXInt, sampleYInt + 1);
-                                PIX *sp11 = (PIX *) getSrcPixelAddress(sampleXInt + 1, sampleYInt + 1);
-                                
-                                double weight = 1.0; // Equal weight for now
-                                totalWeight += weight;
-                                
-                                for (int c = 0; c < nComponents; c++) {
-                                    double sampleValue = sp00[c] * sfx1 * sfy1 +
-                                                       sp10[c] * sfx * sfy1 +
-                                                       sp01[c] * sfx1 * sfy +
-                                                       sp11[c] * sfx * sfy;
-                                    sampledColor[c] += sampleValue * weight;
-                                }
-                            }
-                        }
-                        
-                        // Normalize and apply
-                        if (totalWeight > 0.001) {
-                            for (int c = 0; c < nComponents; c++) {
-                                dstPix[c] = (PIX)(sampledColor[c] / totalWeight);
-                            }
-                        } else {
-                            // Fallback to regular bilinear
-                            for (int c = 0; c < nComponents; c++) {
-                                double interpolated = p00[c] * fx1 * fy1 +
-                                                    p10[c] * fx * fy1 +
-                                                    p01[c] * fx1 * fy +
-                                                    p11[c] * fx * fy;
-                                dstPix[c] = (PIX)interpolated;
-                            }
-                        }
-                    } else {
-                        // Regular bilinear interpolation
-                        for (int c = 0; c < nComponents; c++) {
-                            double interpolated = p00[c] * fx1 * fy1 +
-                                                p10[c] * fx * fy1 +
-                                                p01[c] * fx1 * fy +
-                                                p11[c] * fx * fy;
-                            dstPix[c] = (PIX)interpolated;
-                        }
-                    }
-                } else if (srcXInt >= srcBounds.x1 && srcXInt < srcBounds.x2 && 
-                          srcYInt >= srcBounds.y1 && srcYInt < srcBounds.y2) {
-                    // Nearest neighbor for edge pixels
-                    PIX *srcPix = (PIX *) getSrcPixelAddress(srcXInt, srcYInt);
-                    for (int c = 0; c < nComponents; c++) {
-                        dstPix[c] = srcPix[c];
-                    }
-                } else {
-                    // For completely out-of-bounds pixels, use transparent black or edge clamping
-                    if (x >= srcBounds.x1 && x < srcBounds.x2 && y >= srcBounds.y1 && y < srcBounds.y2) {
-                        // If original position is valid, use it
-                        PIX *srcPix = (PIX *) getSrcPixelAddress(x, y);
-                        for (int c = 0; c < nComponents; c++) {
-                            dstPix[c] = srcPix[c];
-                        }
-                    } else {
-                        // Clamp to nearest edge pixel
-                        int clampX = std::max(srcBounds.x1, std::min(srcBounds.x2-1, srcXInt));
-                        int clampY = std::max(srcBounds.y1, std::min(srcBounds.y2-1, srcYInt));
-                        PIX *srcPix = (PIX *) getSrcPixelAddress(clampX, clampY);
-                        for (int c = 0; c < nComponents; c++) {
-                            dstPix[c] = srcPix[c];
-                        }
-                    }
-                }
-                
-                dstPix += nComponents;
-            }
+            _kernel.processTile(tileWindow);
         }
     }
+    
+    
+    // not used by the tile scheduler, but required by OFX::ImageProcessor
+    virtual void multiThreadProcessImages(const OfxRectI& procWindow, const OfxPointD& /*rs*/)
+    {
+        _kernel.processTile(procWindow);
+    }
 };
 
 void FluidSwirlPlugin::render(const OFX::RenderArguments &args)
@@ -662,6 +277,8 @@ void FluidSwirlPlugin::render(const OFX::RenderArguments &args)
         renderInternal<unsigned short, 4, 65535>(args, srcBitDepth);
     } else if (srcBitDepth == OFX::eBitDepthFloat && srcComponents == OFX::ePixelComponentRGBA) {
         renderInternal<float, 4, 1>(args, srcBitDepth);
+    } else if (srcBitDepth == OFX::eBitDepthHalf && srcComponents == OFX::ePixelComponentRGBA) {
+        renderHalf(args, 4);
     }
     // Handle RGB formats
     else if (srcBitDepth == OFX::eBitDepthUByte && srcComponents == OFX::ePixelComponentRGB) {
@@ -670,6 +287,8 @@ void FluidSwirlPlugin::render(const OFX::RenderArguments &args)
         renderInternal<unsigned short, 3, 65535>(args, srcBitDepth);
     } else if (srcBitDepth == OFX::eBitDepthFloat && srcComponents == OFX::ePixelComponentRGB) {
         renderInternal<float, 3, 1>(args, srcBitDepth);
+    } else if (srcBitDepth == OFX::eBitDepthHalf && srcComponents == OFX::ePixelComponentRGB) {
+        renderHalf(args, 3);
     }
     // Handle Alpha formats
     else if (srcBitDepth == OFX::eBitDepthUByte && srcComponents == OFX::ePixelComponentAlpha) {
@@ -678,6 +297,8 @@ void FluidSwirlPlugin::render(const OFX::RenderArguments &args)
         renderInternal<unsigned short, 1, 65535>(args, srcBitDepth);
     } else if (srcBitDepth == OFX::eBitDepthFloat && srcComponents == OFX::ePixelComponentAlpha) {
         renderInternal<float, 1, 1>(args, srcBitDepth);
+    } else if (srcBitDepth == OFX::eBitDepthHalf && srcComponents == OFX::ePixelComponentAlpha) {
+        renderHalf(args, 1);
     } else {
         OFX::throwSuiteStatusException(kOfxStatErrUnsupported);
     }
@@ -687,11 +308,99 @@ template <class PIX, int nComponents, int maxValue>
 void FluidSwirlPlugin::renderInternal(const OFX::RenderArguments &args,
                                      OFX::BitDepthEnum bitDepth)
 {
-    FluidSwirlProcessor<PIX, nComponents, maxValue> processor(*this);
-    setupAndProcess(processor, args);
+    // Dispatch once to the kernel specialised for the flow mode
+    switch (_flowMode->getValueAtTime(args.time)) {
+        case 0: {
+            FluidSwirlKernel<PIX, nComponents, maxValue, 0> kernel;
+            setupAndProcess(kernel, args);
+            break;
+        }
+        case 1: {
+            FluidSwirlKernel<PIX, nComponents, maxValue, 1> kernel;
+            setupAndProcess(kernel, args);
+            break;
+        }
+        case 2: {
+            FluidSwirlKernel<PIX, nComponents, maxValue, 2> kernel;
+            setupAndProcess(kernel, args);
+            break;
+        }
+        default:
+            OFX::throwSuiteStatusException(kOfxStatErrUnsupported);
+    }
+}
+
+// Half float kernels come from FluidSwirlHalf, which picks the F16C ones at run time
+void FluidSwirlPlugin::renderHalf(const OFX::RenderArguments &args, int nComponents)
+{
+    std::unique_ptr<FluidSwirlKernelBase> kernel(FluidSwirlHalf::createKernel(nComponents, _flowMode->getValueAtTime(args.time)));
+    if (!kernel) {
+        OFX::throwSuiteStatusException(kOfxStatErrUnsupported);
+    }
+    setupAndProcess(*kernel, args);
+}
+
+// Flow mode 2 only moves pixels near the projectile, its start point and the wake between
+// them. Returns false when the mode can displace any pixel of the frame.
+static bool getAffectedRegion(const FluidSwirlParams &p, OfxRectD &region)
+{
+    if (p.flowMode != 2) {
+        return false;
+    }
+    
+    const double progress = p.time / p.projectileSpeed;
+    const double projectileX = p.projectileStartX + progress * (p.projectileEndX - p.projectileStartX);
+    const double projectileY = p.projectileStartY + progress * (p.projectileEndY - p.projectileStartY);
+    
+    // wave around the start, ripples around the projectile and the (expanding) wake width
+    const double waveRadius = std::min(progress * p.projectileRadius * 4.0, p.projectileRadius * 8.0);
+    const double wakeWidth = std::max(p.wakeWidth, p.wakeWidth * (1.0 + progress * 2.0));
+    const double startReach = std::max(std::max(waveRadius, 0.0), wakeWidth);
+    const double projectileReach = std::max(p.projectileRadius * 2.0, wakeWidth);
+    
+    region.x1 = std::min(p.projectileStartX - startReach, projectileX - projectileReach);
+    region.y1 = std::min(p.projectileStartY - startReach, projectileY - projectileReach);
+    region.x2 = std::max(p.projectileStartX + startReach, projectileX + projectileReach);
+    region.y2 = std::max(p.projectileStartY + startReach, projectileY + projectileReach);
+    return true;
+}
+
+// Source pixels the output pixels in window (all in pixel coordinates) can read
+static OfxRectD getSourcePixelRoI(const FluidSwirlParams &p, FluidSwirlKernelBase::EdgeMode edgeMode,
+                                  const OfxRectD &frame, const OfxRectD &window)
+{
+    // Outside the affected region every pixel samples itself (plus its bilinear neighbour)
+    double bound = FluidSwirlKernelBase::getDisplacementBound(p);
+    OfxRectD affected;
+    if (getAffectedRegion(p, affected) &&
+        (affected.x2 <= window.x1 || affected.x1 >= window.x2 || affected.y2 <= window.y1 || affected.y1 >= window.y2)) {
+        bound = 1.0;
+    }
+    
+    OfxRectD roi;
+    roi.x1 = floor(window.x1) - bound;
+    roi.y1 = floor(window.y1) - bound;
+    roi.x2 = ceil(window.x2) + bound;
+    roi.y2 = ceil(window.y2) + bound;
+    
+    // Wrapped reads past one edge of the frame land on the opposite one. Mirrored reads stay
+    // closer to the window than the position they mirror, the other modes never leave it.
+    // The bilinear neighbour of the last pixel alone does not count, its weight is zero
+    // unless the pixel is displaced.
+    if (edgeMode == FluidSwirlKernelBase::eEdgeWrap) {
+        if (roi.x1 < frame.x1 - 1 || roi.x2 > frame.x2 + 1) {
+            roi.x1 = std::min(roi.x1, frame.x1);
+            roi.x2 = std::max(roi.x2, frame.x2);
+        }
+        if (roi.y1 < frame.y1 - 1 || roi.y2 > frame.y2 + 1) {
+            roi.y1 = std::min(roi.y1, frame.y1);
+            roi.y2 = std::max(roi.y2, frame.y2);
+        }
+    }
+    return roi;
 }
 
-void FluidSwirlPlugin::setupAndProcess(FluidSwirlProcessorBase &processor,
+void FluidSwirlPlugin::setupAndProcess(FluidSwirlKernelBase &kernel,
                                       const OFX::RenderArguments &args)
 {
     // Check if clips are connected
@@ -706,65 +415,141 @@ void FluidSwirlPlugin::setupAndProcess(FluidSwirlProcessorBase &processor,
         OFX::throwSuiteStatusException(kOfxStatFailed);
     }
     
-    // Verify image bounds match
-    OfxRectI dstBounds = dst->getBounds();
-    OfxRectI srcBounds = src->getBounds();
-    if (dstBounds.x1 != srcBounds.x1 || dstBounds.y1 != srcBounds.y1 || 
-        dstBounds.x2 != srcBounds.x2 || dstBounds.y2 != srcBounds.y2) {
+    const OfxRectI &srcBounds = src->getBounds();
+    if (srcBounds.x1 >= srcBounds.x2 || srcBounds.y1 >= srcBounds.y2) {
         OFX::throwSuiteStatusException(kOfxStatFailed);
     }
+    
+    // Positions and sizes are relative to the whole source frame, not to the source image,
+    // which only covers what getRegionsOfInterest asked for
+    const OfxRectD frame = getSourcePixelRoD(args.time, args.renderScale);
+    FluidSwirlParams params;
+    getPixelParams(args.time, frame, params);
+    
+    OfxRectI frameBounds;
+    frameBounds.x1 = (int)floor(frame.x1);
+    frameBounds.y1 = (int)floor(frame.y1);
+    frameBounds.x2 = (int)ceil(frame.x2);
+    frameBounds.y2 = (int)ceil(frame.y2);
+    
+    kernel.setDstImage(dst->getImageView());
+    kernel.setSrcImage(src->getImageView(), frameBounds);
+    kernel.setUseSIMD(_useSIMD->getValueAtTime(args.time));
+    kernel.setDisplacementGrid(4 * _displacementGrid->getValueAtTime(args.time));
+    kernel.setComputePrecision((FluidSwirlKernelBase::ComputePrecision)_computePrecision->getValueAtTime(args.time));
+    kernel.setSwirlParams(params);
+    kernel.setAntialiasing(_filtering->getValueAtTime(args.time) == 1);
+    kernel.setEdgeMode((FluidSwirlKernelBase::EdgeMode)_edgeMode->getValueAtTime(args.time));
+    kernel.prepareSource();
+    
+    // Reuse the last displacement field if it was built from the same values and covers
+    // this render window, otherwise fill a new one while rendering. When a host renders a
+    // frame as tiles, the other tiles of the same frame do not replace the field (they
+    // would only evict each other), so they render uncached with per-tile memory only.
+    std::shared_ptr<FluidSwirlDisplacementField> field;
+    bool fieldReady = false;
+    if (_cacheDisplacement->getValueAtTime(args.time)) {
+        std::vector<double> key = kernel.getDisplacementKey();
+        const size_t nPixels = (size_t)(args.renderWindow.x2 - args.renderWindow.x1) *
+                               (args.renderWindow.y2 - args.renderWindow.y1);
+        bool replace = true;
+        {
+            OFX::MultiThread::AutoMutexT<std::mutex> lock(_displacementFieldMutex);
+            const FluidSwirlDisplacementField *cached = _displacementField.get();
+            if (cached && cached->key == key) {
+                if (cached->bounds.x1 <= args.renderWindow.x1 && cached->bounds.x2 >= args.renderWindow.x2 &&
+                    cached->bounds.y1 <= args.renderWindow.y1 && cached->bounds.y2 >= args.renderWindow.y2) {
+                    field = _displacementField;
+                    fieldReady = true;
+                }
+                replace = nPixels > (size_t)(cached->bounds.x2 - cached->bounds.x1) * (cached->bounds.y2 - cached->bounds.y1);
+            }
+        }
+        
+        if (!field && replace) {
+            field.reset(new FluidSwirlDisplacementField);
+            field->key.swap(key);
+            field->bounds = args.renderWindow;
+            field->offsets.resize(2 * nPixels);
+            if (params.flowMode == 2) {
+                field->wakeBlur.resize(nPixels);
+            }
+        }
+    } else {
+        OFX::MultiThread::AutoMutexT<std::mutex> lock(_displacementFieldMutex);
+        _displacementField.reset();
+    }
+    kernel.setDisplacementField(field.get(), fieldReady);
+    
+    FluidSwirlProcessor processor(*this, kernel);
+    processor.setRenderWindow(args.renderWindow, args.renderScale);
+    processor.setTileSize(_tileSize->getValueAtTime(args.time));
+    processor.process();
+    
+    // Only a completely filled field can be handed to later renders
+    if (field && !fieldReady && !abort()) {
+        OFX::MultiThread::AutoMutexT<std::mutex> lock(_displacementFieldMutex);
+        _displacementField = field;
+    }
+}
+
+// Region of definition of the source clip in pixel coordinates at renderScale
+OfxRectD FluidSwirlPlugin::getSourcePixelRoD(double time, const OfxPointD &renderScale)
+{
+    const OfxRectD rod = _srcClip->getRegionOfDefinition(time);
+    const double par = _srcClip->getPixelAspectRatio();
+    
+    OfxRectD frame;
+    frame.x1 = rod.x1 * renderScale.x / par;
+    frame.y1 = rod.y1 * renderScale.y;
+    frame.x2 = rod.x2 * renderScale.x / par;
+    frame.y2 = rod.y2 * renderScale.y;
+    return frame;
+}
 
+// Parameter values at time, with the normalised positions mapped onto frame and the sizes
+// scaled to its diagonal, in the same pixel units the processor works in
+void FluidSwirlPlugin::getPixelParams(double time, const OfxRectD &frame, FluidSwirlParams &params)
+{
     // Get parameter values
-    double swirlIntensity = _swirlIntensity->getValueAtTime(args.time);
-    double centerX, centerY;
-    _center->getValueAtTime(args.time, centerX, centerY);
+    params.swirlIntensity = _swirlIntensity->getValueAtTime(time);
+    _center->getValueAtTime(time, params.centerX, params.centerY);
     
     // Convert normalized coordinates to pixel coordinates
-    int imageWidth = srcBounds.x2 - srcBounds.x1;
-    int imageHeight = srcBounds.y2 - srcBounds.y1;
-    centerX = srcBounds.x1 + centerX * imageWidth;
-    centerY = srcBounds.y1 + centerY * imageHeight;
+    double imageWidth = frame.x2 - frame.x1;
+    double imageHeight = frame.y2 - frame.y1;
+    params.centerX = frame.x1 + params.centerX * imageWidth;
+    params.centerY = frame.y1 + params.centerY * imageHeight;
     
-    double radius = _radius->getValueAtTime(args.time);
-    double decay = _decay->getValueAtTime(args.time);
-    double flowDirection = _flowDirection->getValueAtTime(args.time);
-    double flowStrength = _flowStrength->getValueAtTime(args.time);
-    double wakeWidth = _wakeWidth->getValueAtTime(args.time);
-    double vortexSpacing = _vortexSpacing->getValueAtTime(args.time);
-    int flowMode = _flowMode->getValueAtTime(args.time);
+    params.radius = _radius->getValueAtTime(time);
+    params.decay = _decay->getValueAtTime(time);
+    params.flowDirection = _flowDirection->getValueAtTime(time);
+    params.flowStrength = _flowStrength->getValueAtTime(time);
+    params.wakeWidth = _wakeWidth->getValueAtTime(time);
+    params.vortexSpacing = _vortexSpacing->getValueAtTime(time);
+    params.flowMode = _flowMode->getValueAtTime(time);
     
     // Get projectile parameters
-    double projectileStartX, projectileStartY;
-    _projectileStart->getValueAtTime(args.time, projectileStartX, projectileStartY);
-    double projectileEndX, projectileEndY;
-    _projectileEnd->getValueAtTime(args.time, projectileEndX, projectileEndY);
-    double projectileSpeed = _projectileSpeed->getValueAtTime(args.time);
-    double projectileRadius = _projectileRadius->getValueAtTime(args.time);
-    double wakeDecay = _wakeDecay->getValueAtTime(args.time);
+    _projectileStart->getValueAtTime(time, params.projectileStartX, params.projectileStartY);
+    _projectileEnd->getValueAtTime(time, params.projectileEndX, params.projectileEndY);
+    params.projectileSpeed = _projectileSpeed->getValueAtTime(time);
+    params.projectileRadius = _projectileRadius->getValueAtTime(time);
+    params.wakeDecay = _wakeDecay->getValueAtTime(time);
+    params.time = time;
     
     // Convert normalized projectile coordinates to pixel coordinates
-    projectileStartX = srcBounds.x1 + projectileStartX * imageWidth;
-    projectileStartY = srcBounds.y1 + projectileStartY * imageHeight;
-    projectileEndX = srcBounds.x1 + projectileEndX * imageWidth;
-    projectileEndY = srcBounds.y1 + projectileEndY * imageHeight;
+    params.projectileStartX = frame.x1 + params.projectileStartX * imageWidth;
+    params.projectileStartY = frame.y1 + params.projectileStartY * imageHeight;
+    params.projectileEndX = frame.x1 + params.projectileEndX * imageWidth;
+    params.projectileEndY = frame.y1 + params.projectileEndY * imageHeight;
     
     // Scale parameters to image size (assuming 1920x1080 reference)
-    double scale = sqrt((double)imageWidth * imageWidth + (double)imageHeight * imageHeight) / sqrt(1920.0 * 1920.0 + 1080.0 * 1080.0);
-    radius *= scale;
-    decay *= scale;
-    wakeWidth *= scale;
-    vortexSpacing *= scale;
-    projectileRadius *= scale;
-
-    processor.setDstImg(dst.get());
-    processor.setSrcImg(src.get());
-    processor.setRenderWindow(args.renderWindow);
-    processor.setSwirlParams(swirlIntensity, centerX, centerY, radius, decay,
-                           flowDirection, flowStrength, wakeWidth, vortexSpacing, flowMode,
-                           projectileStartX, projectileStartY, projectileEndX, projectileEndY,
-                           projectileSpeed, projectileRadius, wakeDecay, args.time);
-    
-    processor.process();
+    double scale = sqrt(imageWidth * imageWidth + imageHeight * imageHeight) / sqrt(1920.0 * 1920.0 + 1080.0 * 1080.0);
+    params.radius *= scale;
+    params.decay *= scale;
+    params.wakeWidth *= scale;
+    params.vortexSpacing *= scale;
+    params.projectileRadius *= scale;
 }
 
 bool FluidSwirlPlugin::isIdentity(const OFX::IsIdentityArguments &args, OFX::Clip * &identityClip, double &identityTime)
@@ -812,6 +597,34 @@ bool FluidSwirlPlugin::getRegionOfDefinition(const OFX::RegionOfDefinitionArgume
     return false;
 }
 
+void FluidSwirlPlugin::getRegionsOfInterest(const OFX::RegionsOfInterestArguments &args, OFX::RegionOfInterestSetter &rois)
+{
+    if (!_srcClip || !_srcClip->isConnected()) {
+        return;
+    }
+    
+    // Work in source pixels, where the displacement bound is known
+    const OfxRectD frame = getSourcePixelRoD(args.time, args.renderScale);
+    FluidSwirlParams params;
+    getPixelParams(args.time, frame, params);
+    
+    const double par = _srcClip->getPixelAspectRatio();
+    OfxRectD roi;
+    roi.x1 = args.regionOfInterest.x1 * args.renderScale.x / par;
+    roi.y1 = args.regionOfInterest.y1 * args.renderScale.y;
+    roi.x2 = args.regionOfInterest.x2 * args.renderScale.x / par;
+    roi.y2 = args.regionOfInterest.y2 * args.renderScale.y;
+    
+    // Everything the window can read, back in canonical coordinates
+    const FluidSwirlKernelBase::EdgeMode edgeMode = (FluidSwirlKernelBase::EdgeMode)_edgeMode->getValueAtTime(args.time);
+    OfxRectD srcRoI = getSourcePixelRoI(params, edgeMode, frame, roi);
+    srcRoI.x1 = srcRoI.x1 * par / args.renderScale.x;
+    srcRoI.y1 = srcRoI.y1 / args.renderScale.y;
+    srcRoI.x2 = srcRoI.x2 * par / args.renderScale.x;
+    srcRoI.y2 = srcRoI.y2 / args.renderScale.y;
+    rois.setRegionOfInterest(*_srcClip, srcRoI);
+}
+
 class FluidSwirlPluginFactory : public OFX::PluginFactoryHelper<FluidSwirlPluginFactory>
 {
 public:
@@ -830,6 +643,7 @@ void FluidSwirlPluginFactory::describe(OFX::ImageEffectDescriptor &desc)
     desc.addSupportedContext(OFX::eContextFilter);
     desc.addSupportedBitDepth(OFX::eBitDepthUByte);
     desc.addSupportedBitDepth(OFX::eBitDepthUShort);
+    desc.addSupportedBitDepth(OFX::eBitDepthHalf);
     desc.addSupportedBitDepth(OFX::eBitDepthFloat);
     desc.setSingleInstance(false);
     desc.setHostFrameThreading(false);
@@ -1021,6 +835,103 @@ void FluidSwirlPluginFactory::describeInContext(OFX::ImageEffectDescriptor &desc
     if (page) {
         page->addChild(*param);
     }
+
+    // Filtering
+    choiceParam = desc.defineChoiceParam(kParamFiltering);
+    choiceParam->setLabel(kParamFilteringLabel);
+    choiceParam->setHint(kParamFilteringHint);
+    choiceParam->appendOption("Bilinear", "One bilinear tap per pixel");
+    choiceParam->appendOption("Anti-aliased", "Trilinear taps from a source mip pyramid where the effect squeezes the image");
+    choiceParam->setDefault(0);
+    if (page) {
+        page->addChild(*choiceParam);
+    }
+
+    // Edge mode, in FluidSwirlKernelBase::EdgeMode order
+    choiceParam = desc.defineChoiceParam(kParamEdgeMode);
+    choiceParam->setLabel(kParamEdgeModeLabel);
+    choiceParam->setHint(kParamEdgeModeHint);
+    choiceParam->appendOption("Clamp", "The edge pixels repeat");
+    choiceParam->appendOption("Mirror", "The image continues mirrored");
+    choiceParam->appendOption("Wrap", "The image repeats from the opposite edge");
+    choiceParam->appendOption("Transparent", "Transparent black");
+    choiceParam->setDefault(0);
+    if (page) {
+        page->addChild(*choiceParam);
+    }
+
+    // Advanced (performance tuning, does not change the image)
+    OFX::GroupParamDescriptor *advancedGroup = desc.defineGroupParam(kGroupAdvanced);
+    advancedGroup->setLabel(kGroupAdvancedLabel);
+    advancedGroup->setOpen(false);
+    if (page) {
+        page->addChild(*advancedGroup);
+    }
+
+    // Render Tile Size
+    OFX::IntParamDescriptor *intParam = desc.defineIntParam(kParamTileSize);
+    intParam->setLabel(kParamTileSizeLabel);
+    intParam->setHint(kParamTileSizeHint);
+    intParam->setDefault(kParamTileSizeDefault);
+    intParam->setRange(16, 1024);
+    intParam->setDisplayRange(32, 256);
+    intParam->setAnimates(false);
+    intParam->setEvaluateOnChange(false);
+    intParam->setParent(*advancedGroup);
+    if (page) {
+        page->addChild(*intParam);
+    }
+
+    // Vector Instructions
+    OFX::BooleanParamDescriptor *boolParam = desc.defineBooleanParam(kParamUseSIMD);
+    boolParam->setLabel(kParamUseSIMDLabel);
+    boolParam->setHint(kParamUseSIMDHint);
+    boolParam->setDefault(true);
+    boolParam->setAnimates(false);
+    boolParam->setParent(*advancedGroup);
+    if (page) {
+        page->addChild(*boolParam);
+    }
+
+    // Displacement Grid
+    choiceParam = desc.defineChoiceParam(kParamDisplacementGrid);
+    choiceParam->setLabel(kParamDisplacementGridLabel);
+    choiceParam->setHint(kParamDisplacementGridHint);
+    choiceParam->appendOption("Every Pixel", "Exact displacement for every pixel");
+    choiceParam->appendOption("Adaptive 4x4", "Exact displacement every 4 pixels, interpolated where smooth");
+    choiceParam->appendOption("Adaptive 8x8", "Exact displacement every 8 pixels, interpolated where smooth");
+    choiceParam->setDefault(0);
+    choiceParam->setAnimates(false);
+    choiceParam->setParent(*advancedGroup);
+    if (page) {
+        page->addChild(*choiceParam);
+    }
+
+    // Compute Precision
+    choiceParam = desc.defineChoiceParam(kParamComputePrecision);
+    choiceParam->setLabel(kParamComputePrecisionLabel);
+    choiceParam->setHint(kParamComputePrecisionHint);
+    choiceParam->appendOption("Automatic", "Single precision unless the frame coordinates are too large for it or the flow mode is Projectile Wake");
+    choiceParam->appendOption("Single", "Always single precision");
+    choiceParam->appendOption("Double", "Always double precision");
+    choiceParam->setDefault(0);
+    choiceParam->setAnimates(false);
+    choiceParam->setParent(*advancedGroup);
+    if (page) {
+        page->addChild(*choiceParam);
+    }
+
+    // Cache Displacement
+    boolParam = desc.defineBooleanParam(kParamCacheDisplacement);
+    boolParam->setLabel(kParamCacheDisplacementLabel);
+    boolParam->setHint(kParamCacheDisplacementHint);
+    boolParam->setDefault(true);
+    boolParam->setAnimates(false);
+    boolParam->setEvaluateOnChange(false);
+    boolParam->setParent(*advancedGroup);
+    if (page) {
+        page->addChild(*boolParam);
+    }
 }
 
 OFX::ImageEffect* FluidSwirlPluginFactory::createInstance(OfxImageEffectHandle handle, OFX::ContextEnum context)
@@ -0,0 +1,183 @@
+#pragma once
+
+// Box filtered mip levels of a region of the source image, for blurs whose size changes from
+// pixel to pixel (the flow mode 2 wake diffusion and the anti-aliased filtering).
+//
+// Level k holds the average of every 2^k x 2^k block of source pixels, with the blocks
+// aligned to multiples of 2^k in frame coordinates, so two renders that fetched the same
+// pixels (neighbouring tiles of one frame) build the same texels. Blocks cut by the edge of
+// the region average the pixels inside it only. Level 0 is the source itself and is not
+// stored; the levels are float whatever the pixel format.
+
+#include "ofxsImageEffect.h"
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+class FluidSwirlMipPyramid
+{
+    struct Level {
+        int x1, y1;             // first texel, in texels of this level
+        int width, height;
+        std::vector<float> texels;
+    };
+
+    std::vector<Level> _levels; // levels 1, 2, ...
+
+    // floor(v / 2^level) and ceil(v / 2^level), also for negative v
+    static int floorShift(int v, int level) { return v >= 0 ? v >> level : -((-v + (1 << level) - 1) >> level); }
+    static int ceilShift(int v, int level) { return -floorShift(-v, level); }
+
+    // Number of region pixels block i of level covers along one axis (level 0 blocks are
+    // single pixels), at most 0 outside the region
+    static int getCoverage(int i, int level, int r1, int r2)
+    {
+        return std::min(r2, (i + 1) << level) - std::max(r1, i << level);
+    }
+
+    // One row of texels from the two child rows row0 and row1 (weighted wy0 and wy1): texel i
+    // averages the children at columns[2i] and columns[2i + 1] with weights[2i], weights[2i + 1].
+    // Where all four children are whole (weight full) and side by side the texel is their plain
+    // mean, summed in int for the integer formats.
+    template <class T, int nComponents>
+    static void downsampleRow(const T *row0, const T *row1, float wy0, float wy1, float full,
+                              const std::vector<int> &columns, const std::vector<float> &weights,
+                              int width, float *texel)
+    {
+        typedef decltype(T() + T()) Sum;
+        for (int i = 0; i < width; i++, texel += nComponents) {
+            const T *a0 = row0 + columns[2 * i] * nComponents;
+            const T *a1 = row0 + columns[2 * i + 1] * nComponents;
+            const T *b0 = row1 + columns[2 * i] * nComponents;
+            const T *b1 = row1 + columns[2 * i + 1] * nComponents;
+            const float wx0 = weights[2 * i], wx1 = weights[2 * i + 1];
+            if (wx0 == full && wx1 == full && wy0 == full && wy1 == full) {
+                // the rest of the row up to the last texel is whole as well
+                const int iEnd = weights[2 * width - 1] == full && weights[2 * width - 2] == full ? width : width - 1;
+                for (; i < iEnd; i++, a0 += 2 * nComponents, b0 += 2 * nComponents, texel += nComponents) {
+                    for (int c = 0; c < nComponents; c++) {
+                        const Sum sum = a0[c] + a0[c + nComponents] + b0[c] + b0[c + nComponents];
+                        texel[c] = (float)sum * 0.25f;
+                    }
+                }
+                i--;
+                texel -= nComponents;
+                continue;
+            }
+            const float scale = 1.0f / ((wx0 + wx1) * (wy0 + wy1));
+            for (int c = 0; c < nComponents; c++) {
+                const float top = wx0 * (float)a0[c] + wx1 * (float)a1[c];
+                const float bottom = wx0 * (float)b0[c] + wx1 * (float)b1[c];
+                texel[c] = (wy0 * top + wy1 * bottom) * scale;
+            }
+        }
+    }
+
+public:
+    void clear() { _levels.clear(); }
+
+    // Levels stored besides the source, 0 when empty
+    int getLevelCount() const { return (int)_levels.size(); }
+
+    // Builds levels 1..nLevels of region, which src must hold, from its nComponents PIX
+    // pixels. Smaller levels stop at one texel.
+    template <class PIX, int nComponents>
+    void build(const OFX::ConstImageView &src, const OfxRectI &region, int nLevels)
+    {
+        _levels.clear();
+        if (region.x1 >= region.x2 || region.y1 >= region.y2) {
+            return;
+        }
+
+        std::vector<int> columns;
+        std::vector<float> weights;
+        for (int level = 1; level <= nLevels; level++) {
+            Level l;
+            l.x1 = floorShift(region.x1, level);
+            l.y1 = floorShift(region.y1, level);
+            l.width = ceilShift(region.x2, level) - l.x1;
+            l.height = ceilShift(region.y2, level) - l.y1;
+            l.texels.resize((size_t)l.width * l.height * nComponents);
+
+            // Each texel averages its (up to) 2 x 2 children weighted by the region pixels they
+            // cover, so it is the exact mean of its block. Children outside the region get no
+            // weight and are read from their neighbour instead.
+            const Level *child = level > 1 ? &_levels.back() : NULL;
+            const float full = (float)(1 << (level - 1));
+            const int childX1 = child ? child->x1 : region.x1;
+            const int childY1 = child ? child->y1 : region.y1;
+            columns.resize(2 * l.width);
+            weights.resize(2 * l.width);
+            for (int i = 0; i < l.width; i++) {
+                for (int k = 0; k < 2; k++) {
+                    const int ci = 2 * (l.x1 + i) + k;
+                    const int weight = getCoverage(ci, level - 1, region.x1, region.x2);
+                    columns[2 * i + k] = (weight > 0 ? ci : 2 * (l.x1 + i) + 1 - k) - childX1;
+                    weights[2 * i + k] = (float)std::max(weight, 0);
+                }
+            }
+
+            for (int j = 0; j < l.height; j++) {
+                int rows[2];
+                float rowWeights[2];
+                for (int k = 0; k < 2; k++) {
+                    const int cj = 2 * (l.y1 + j) + k;
+                    const int weight = getCoverage(cj, level - 1, region.y1, region.y2);
+                    rows[k] = weight > 0 ? cj : 2 * (l.y1 + j) + 1 - k;
+                    rowWeights[k] = (float)std::max(weight, 0);
+                }
+                float *texel = &l.texels[(size_t)j * l.width * nComponents];
+                if (child) {
+                    const float *row0 = &child->texels[(size_t)(rows[0] - childY1) * child->width * nComponents];
+                    const float *row1 = &child->texels[(size_t)(rows[1] - childY1) * child->width * nComponents];
+                    downsampleRow<float, nComponents>(row0, row1, rowWeights[0], rowWeights[1], full, columns, weights, l.width, texel);
+                } else {
+                    const PIX *row0 = (const PIX *) src.getPixelAddress(region.x1, rows[0]);
+                    const PIX *row1 = (const PIX *) src.getPixelAddress(region.x1, rows[1]);
+                    downsampleRow<PIX, nComponents>(row0, row1, rowWeights[0], rowWeights[1], full, columns, weights, l.width, texel);
+                }
+            }
+
+            const bool last = l.width == 1 && l.height == 1;
+            _levels.push_back(std::move(l));
+            if (last) {
+                break;
+            }
+        }
+    }
+
+    // Bilinear sample of level (1..getLevelCount()) at source pixel position (x, y), where
+    // integer positions are pixel centres like in the resampler. Texels outside the region
+    // are clamped to its edge.
+    template <int nComponents, class Real>
+    void sample(int level, Real x, Real y, Real *values) const
+    {
+        const Level &l = _levels[level - 1];
+        const Real scale = Real(1) / (1 << level);
+        const Real u = (x + Real(0.5)) * scale - Real(0.5);
+        const Real v = (y + Real(0.5)) * scale - Real(0.5);
+        // floor without the library call: truncate, then step down for negative fractions
+        int uFloor = (int)u;
+        int vFloor = (int)v;
+        uFloor -= u < (Real)uFloor;
+        vFloor -= v < (Real)vFloor;
+        const Real fx = u - (Real)uFloor;
+        const Real fy = v - (Real)vFloor;
+
+        const int i0 = std::max(0, std::min(l.width - 1, uFloor - l.x1));
+        const int i1 = std::max(0, std::min(l.width - 1, uFloor + 1 - l.x1));
+        const int j0 = std::max(0, std::min(l.height - 1, vFloor - l.y1));
+        const int j1 = std::max(0, std::min(l.height - 1, vFloor + 1 - l.y1));
+        const float *t00 = &l.texels[((size_t)j0 * l.width + i0) * nComponents];
+        const float *t10 = &l.texels[((size_t)j0 * l.width + i1) * nComponents];
+        const float *t01 = &l.texels[((size_t)j1 * l.width + i0) * nComponents];
+        const float *t11 = &l.texels[((size_t)j1 * l.width + i1) * nComponents];
+        for (int c = 0; c < nComponents; c++) {
+            const Real top = t00[c] + fx * (t10[c] - t00[c]);
+            const Real bottom = t01[c] + fx * (t11[c] - t01[c]);
+            values[c] = top + fy * (bottom - top);
+        }
+    }
+};
@@ -0,0 +1,221 @@
+// Runtime selection of the vector kernels. This file is built without any instruction
+// set flags, so it is safe to run on every CPU the plugin loads on.
+
+#include "FluidSwirlSIMD.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(FLUIDSWIRL_X86_SIMD) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(FLUIDSWIRL_X86_SIMD)
+#include <cpuid.h>
+#endif
+
+namespace FluidSwirlSIMD {
+
+    namespace {
+
+        enum InstructionSet {
+            eScalar,
+            eAVX2,
+            eAVX512
+        };
+
+#ifdef FLUIDSWIRL_X86_SIMD
+#ifdef _MSC_VER
+        // CPUID plus a check that the OS saves the AVX (and AVX-512) register state
+        InstructionSet detectInstructionSet()
+        {
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) {
+                return eScalar;
+            }
+
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool fma = (info[2] & (1 << 12)) != 0;
+            if (!osxsave) {
+                return eScalar;
+            }
+            const unsigned long long xcr0 = _xgetbv(0);
+
+            __cpuidex(info, 7, 0);
+            const bool avx2 = (info[1] & (1 << 5)) != 0;
+            const bool avx512f = (info[1] & (1 << 16)) != 0;
+
+            if (avx512f && (xcr0 & 0xe6) == 0xe6) {
+                return eAVX512;
+            }
+            if (avx2 && fma && (xcr0 & 0x6) == 0x6) {
+                return eAVX2;
+            }
+            return eScalar;
+        }
+
+        // AVX2 and FMA on their own, for the kernels the AVX-512 level shares with AVX2
+        bool detectAVX2()
+        {
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) {
+                return false;
+            }
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool fma = (info[2] & (1 << 12)) != 0;
+            if (!osxsave || !fma || (_xgetbv(0) & 0x6) != 0x6) {
+                return false;
+            }
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+        }
+
+        // F16C uses the VEX encoding, so it also needs the OS to save the AVX register state
+        bool detectF16C()
+        {
+            int info[4];
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx = (info[2] & (1 << 28)) != 0;
+            const bool f16c = (info[2] & (1 << 29)) != 0;
+            return osxsave && avx && f16c && (_xgetbv(0) & 0x6) == 0x6;
+        }
+#else
+        // GCC and Clang check CPUID and the OS register state for us
+        bool detectAVX2()
+        {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        }
+
+        InstructionSet detectInstructionSet()
+        {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) {
+                return eAVX512;
+            }
+            if (detectAVX2()) {
+                return eAVX2;
+            }
+            return eScalar;
+        }
+
+        // F16C from CPUID leaf 1, not every compiler knows it as a __builtin_cpu_supports name
+        bool detectF16C()
+        {
+            unsigned int eax, ebx, ecx, edx;
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx") && __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 29)) != 0;
+        }
+#endif
+#else
+        InstructionSet detectInstructionSet()
+        {
+            return eScalar;
+        }
+
+        bool detectF16C()
+        {
+            return false;
+        }
+#endif
+
+        InstructionSet getInstructionSet()
+        {
+            static const InstructionSet instructionSet = detectInstructionSet();
+            return instructionSet;
+        }
+
+#ifdef FLUIDSWIRL_X86_SIMD
+        bool hasAVX2()
+        {
+            static const bool avx2 = detectAVX2();
+            return avx2;
+        }
+#endif
+
+    }
+
+    bool hasF16C()
+    {
+        static const bool f16c = detectF16C();
+        return f16c;
+    }
+
+    RadialSwirlRowFunc getRadialSwirlRow()
+    {
+#ifdef FLUIDSWIRL_X86_SIMD
+        switch (getInstructionSet()) {
+            case eAVX512:
+                return radialSwirlRowAVX512;
+            case eAVX2:
+                return radialSwirlTableRowAVX2;
+            default:
+                break;
+        }
+#endif
+        return radialSwirlTableRowScalar;
+    }
+
+    BilinearRowFunc getBilinearRow(PixelType type, int nComponents)
+    {
+#ifdef FLUIDSWIRL_X86_SIMD
+        // the AVX2 kernels for AVX-512 as well, 8 pixels per iteration is all a row of
+        // scattered taps can keep busy. AVX-512F does not promise AVX2 and FMA, so they are
+        // checked on their own.
+        if (hasAVX2()) {
+            if (type == ePixelUByte && nComponents == 4) {
+                return bilinearRowUByte4AVX2;
+            }
+            if (type == ePixelFloat) {
+                switch (nComponents) {
+                    case 1:
+                        return bilinearRowFloat1AVX2;
+                    case 3:
+                        return bilinearRowFloat3AVX2;
+                    case 4:
+                        return bilinearRowFloat4AVX2;
+                    default:
+                        break;
+                }
+            }
+        }
+#else
+        (void)type;
+        (void)nComponents;
+#endif
+        return NULL;
+    }
+
+    void radialSwirlTableRowScalar(const RadialSwirlParams &params, int y, int x1, int x2, float *offsets)
+    {
+        const float dy = (float)(y - params.centerY);
+        const float lastIndex = (float)(params.tableSize - 1);
+        for (int x = x1; x < x2; x++) {
+            const float dx = (float)(x - params.centerX);
+            const float t = std::min(std::sqrt(dx * dx + dy * dy) * params.tableScale, lastIndex);
+            const int i = (int)t;
+            const float frac = t - (float)i;
+            const float *entry = params.table + kRadialTableStride * i;
+            const float cosAMinus1 = entry[0] + frac * entry[2];
+            const float sinA = entry[1] + frac * entry[3];
+            offsets[2 * (x - x1)] = dx * cosAMinus1 - dy * sinA;
+            offsets[2 * (x - x1) + 1] = dx * sinA + dy * cosAMinus1;
+        }
+    }
+
+    const char *getInstructionSetName()
+    {
+        switch (getInstructionSet()) {
+            case eAVX512:
+                return "AVX-512";
+            case eAVX2:
+                return "AVX2";
+            default:
+                return "scalar";
+        }
+    }
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+// Vectorized displacement kernels, selected at load time from what the CPU supports.
+//
+// Each kernel fills the source offsets (srcX - x, srcY - y) for one row segment of the
+// output, in the same interleaved float layout as FluidSwirlDisplacementField. The
+// vector kernels are compiled in their own translation units with AVX2/AVX-512 enabled,
+// so nothing outside them may be called unless the matching dispatch test succeeded.
+// The portable fallback lives in FluidSwirlSIMD.cpp.
+//
+// The bilinear row kernels are the vector counterpart of the per pixel taps in
+// FluidSwirlKernel::resampleRow, for the pixel formats where they pay off.
+
+#include <cstddef>
+
+namespace FluidSwirlSIMD {
+
+    // Radial swirl (flow mode 0) in pixel units. The scalar code rotates each pixel by
+    // intensity * exp(-distance / decay) around the centre; callers set intensity to 0
+    // when the decay is too small to use, which makes every offset zero.
+    struct RadialSwirlParams {
+        double centerX, centerY;
+        float intensity;
+        float invDecay;
+
+        // Rotation table for the table kernels, kRadialTableStride floats per entry: cos(s) - 1,
+        // sin(s) and their differences to the next entry, for the swirl angle s at distance
+        // i / tableScale. Distances past the last entry (tableSize - 1, always zero) do not move.
+        const float *table;
+        float tableScale;
+        int tableSize;
+    };
+
+    static const int kRadialTableStride = 4;
+
+    // Error bound of the AVX-512 polynomial kernel against the double precision scalar path,
+    // per offset component, measured over random centres, decays and |intensity| <= 10 in an
+    // 8K frame:
+    //     |error| <= 3e-7 * distance from the centre * (1 + |swirl angle|) + 1e-4 pixels
+    // i.e. at most about 1/400 pixel. The exp and sin/cos polynomials are good to a few
+    // float ulps; what remains is the float rounding of distance * angle.
+    typedef void (*RadialSwirlRowFunc)(const RadialSwirlParams &params, int y, int x1, int x2, float *offsets);
+
+    // Fastest radial swirl row kernel for this CPU. The AVX-512 kernel evaluates the
+    // polynomials; the AVX2 and portable kernels interpolate the rotation from params.table
+    // instead (within 1/1000 pixel of the scalar path), as gathering from the table beats
+    // the polynomials with AVX2 but not with AVX-512.
+    RadialSwirlRowFunc getRadialSwirlRow();
+
+    // Source of the bilinear row kernels: the pixels x1..x2-1 of rows y1..y2-1 (at least 2 x 2),
+    // pixel (x, y) at origin + (y - y1) * rowBytes + (x - x1) * pixel size. The kernels index
+    // components with ints, so (y2 - y1) * rowBytes must stay below 2^31 bytes.
+    struct BilinearSource {
+        const void *origin;
+        ptrdiff_t rowBytes;
+        int x1, y1, x2, y2;
+    };
+
+    enum PixelType {
+        ePixelUByte,
+        ePixelUShort,
+        ePixelHalf,
+        ePixelFloat
+    };
+
+    // Writes the bilinear taps of pixels x1..x2-1 of row y, from the source positions
+    // x + offsets[2i], y + offsets[2i + 1] clamped to the source (the clamp edge mode), to
+    // dstPix. Bit for bit the taps of the scalar resampler in float precision. Returns how many
+    // pixels had taps outside the source before the clamp, and lists their indices i in
+    // ascending order in edgePixels (room for x2 - x1), for callers with other edge modes.
+    typedef int (*BilinearRowFunc)(const BilinearSource &src, int y, int x1, int x2, const float *offsets,
+                                   void *dstPix, int *edgePixels);
+
+    // Bilinear row kernel for nComponents (1, 3 or 4) pixels of type on this CPU, or NULL
+    // where the per pixel taps are as fast: 8-bit RGBA loads the two horizontal neighbours of
+    // each row as one 64-bit pair, float RGBA as one 256-bit pair, float with 1 and 3
+    // components gathers 8 pixels at once. Nothing for the other formats yet.
+    BilinearRowFunc getBilinearRow(PixelType type, int nComponents);
+
+    // "AVX-512", "AVX2" or "scalar", for logging and benchmarks
+    const char *getInstructionSetName();
+
+    // Whether the CPU (and OS) support the F16C half float conversions, see FluidSwirlHalf.hpp
+    bool hasF16C();
+
+#ifdef FLUIDSWIRL_X86_SIMD
+    // Implementations, only valid on CPUs that support them
+    void radialSwirlRowAVX512(const RadialSwirlParams &params, int y, int x1, int x2, float *offsets);
+    void radialSwirlTableRowAVX2(const RadialSwirlParams &params, int y, int x1, int x2, float *offsets);
+    int bilinearRowUByte4AVX2(const BilinearSource &src, int y, int x1, int x2, const float *offsets,
+                              void *dstPix, int *edgePixels);
+    int bilinearRowFloat1AVX2(const BilinearSource &src, int y, int x1, int x2, const float *offsets,
+                              void *dstPix, int *edgePixels);
+    int bilinearRowFloat3AVX2(const BilinearSource &src, int y, int x1, int x2, const float *offsets,
+                              void *dstPix, int *edgePixels);
+    int bilinearRowFloat4AVX2(const BilinearSource &src, int y, int x1, int x2, const float *offsets,
+                              void *dstPix, int *edgePixels);
+#endif
+    void radialSwirlTableRowScalar(const RadialSwirlParams &params, int y, int x1, int x2, float *offsets);
+
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+// Radial swirl kernel bodies for the AVX2 and AVX-512 translation units. Each of them
+// defines a small wrapper struct V around its intrinsics (float vector F, int vector I, lane
+// count kWidth) and instantiates the templates it uses: AVX-512 the polynomial
+// radialSwirlRow, AVX2 the table radialSwirlTableRow.
+//
+// Only include this from a file compiled with the matching instruction set enabled.
+
+#include "FluidSwirlSIMD.hpp"
+
+namespace FluidSwirlSIMD {
+
+    // exp(x) for x <= 0: x = n*ln2 + r with |r| <= ln2/2, 2^n built in the exponent bits
+    // and a degree 6 polynomial for exp(r). Inputs below -87 are clamped, which still gives
+    // a result far below anything that can move a pixel.
+    template <class V>
+    inline typename V::F expNegative(typename V::F x)
+    {
+        typedef typename V::F F;
+        typedef typename V::I I;
+
+        x = V::max(x, V::set1(-87.0f));
+
+        const F n = V::roundNearest(V::mul(x, V::set1(1.44269504088896341f)));
+        F r = V::fmadd(n, V::set1(-0.693359375f), x);
+        r = V::fmadd(n, V::set1(2.12194440e-4f), r);
+
+        F p = V::set1(1.9875691500e-4f);
+        p = V::fmadd(p, r, V::set1(1.3981999507e-3f));
+        p = V::fmadd(p, r, V::set1(8.3334519073e-3f));
+        p = V::fmadd(p, r, V::set1(4.1665795894e-2f));
+        p = V::fmadd(p, r, V::set1(1.6666665459e-1f));
+        p = V::fmadd(p, r, V::set1(5.0000001201e-1f));
+        p = V::fmadd(p, V::mul(r, r), V::add(r, V::set1(1.0f)));
+
+        const I e = V::shiftLeft23(V::addi(V::toInt(n), V::set1i(127)));
+        return V::mul(p, V::asFloat(e));
+    }
+
+    // sin(a), cos(a) and cos(a) - 1 for |a| up to a few thousand. The argument is reduced by
+    // multiples of pi/2 in three steps (Cody-Waite) and evaluated with the Cephes minimax
+    // polynomials on [-pi/4, pi/4]. cos(a) - 1 comes straight from the polynomial in the
+    // first quadrant, so small angles keep their precision when multiplied by a distance.
+    template <class V>
+    inline void sinCos(typename V::F a, typename V::F &sinA, typename V::F &cosAMinus1)
+    {
+        typedef typename V::F F;
+        typedef typename V::I I;
+
+        const F k = V::roundNearest(V::mul(a, V::set1(0.636619772367581343f)));
+        F r = V::fmadd(k, V::set1(-1.5703125f), a);
+        r = V::fmadd(k, V::set1(-4.837512969970703125e-4f), r);
+        r = V::fmadd(k, V::set1(-7.54978995489188216e-8f), r);
+        const F r2 = V::mul(r, r);
+
+        F s = V::set1(-1.9515295891e-4f);
+        s = V::fmadd(s, r2, V::set1(8.3321608736e-3f));
+        s = V::fmadd(s, r2, V::set1(-1.6666654611e-1f));
+        s = V::fmadd(V::mul(s, r2), r, r);
+
+        F cm1 = V::set1(2.443315711809948e-5f);
+        cm1 = V::fmadd(cm1, r2, V::set1(-1.388731625493765e-3f));
+        cm1 = V::fmadd(cm1, r2, V::set1(4.166664568298827e-2f));
+        cm1 = V::fmadd(cm1, r2, V::set1(-0.5f));
+        cm1 = V::mul(cm1, r2);
+        const F c = V::add(cm1, V::set1(1.0f));
+
+        // quadrant q: sin(a) = sin r, cos r, -sin r, -cos r and cos(a) = cos r, -sin r, -cos r, sin r
+        const I q = V::toInt(k);
+        const I odd = V::andi(q, V::set1i(1));
+        F sinV = V::select(odd, c, s);
+        F cosV = V::select(odd, s, c);
+        sinV = V::flipSign(sinV, V::shiftLeft30(V::andi(q, V::set1i(2))));
+        cosV = V::flipSign(cosV, V::shiftLeft30(V::andi(V::addi(q, V::set1i(1)), V::set1i(2))));
+
+        sinA = sinV;
+        cosAMinus1 = V::select(V::andi(q, V::set1i(3)), V::sub(cosV, V::set1(1.0f)), cm1);
+    }
+
+    // Radial swirl offsets for one row. Rotating (dx, dy) by angle s around the centre gives
+    //     srcX - x = dx * (cos s - 1) - dy * sin s
+    //     srcY - y = dx * sin s + dy * (cos s - 1)
+    // which is the scalar atan2/cos/sin form without the atan2 and without adding the
+    // centre back, so the offsets never lose precision to the absolute pixel position.
+    template <class V>
+    inline void radialSwirlRow(const RadialSwirlParams &params, int y, int x1, int x2, float *offsets)
+    {
+        typedef typename V::F F;
+
+        // distances from the centre are formed in double (once per row and vector), so float
+        // only rounds the distance and not the absolute pixel coordinates
+        const F dy = V::set1((float)(y - params.centerY));
+        const F dy2 = V::mul(dy, dy);
+        const F negInvDecay = V::set1(-params.invDecay);
+        const F intensity = V::set1(params.intensity);
+
+        alignas(64) float offsetX[V::kWidth];
+        alignas(64) float offsetY[V::kWidth];
+
+        for (int x = x1; x < x2; x += V::kWidth) {
+            const F dx = V::ramp((float)(x - params.centerX));
+            const F distance = V::sqrt(V::fmadd(dx, dx, dy2));
+            const F angle = V::mul(intensity, expNegative<V>(V::mul(distance, negInvDecay)));
+
+            F sinA, cosAMinus1;
+            sinCos<V>(angle, sinA, cosAMinus1);
+
+            V::store(offsetX, V::fmsub(dx, cosAMinus1, V::mul(dy, sinA)));
+            V::store(offsetY, V::fmadd(dx, sinA, V::mul(dy, cosAMinus1)));
+
+            // the last vector may run past x2, only the pixels inside the row are written
+            const int n = x2 - x < V::kWidth ? x2 - x : V::kWidth;
+            for (int i = 0; i < n; i++) {
+                offsets[2 * (x - x1 + i)] = offsetX[i];
+                offsets[2 * (x - x1 + i) + 1] = offsetY[i];
+            }
+        }
+    }
+
+    // Radial swirl offsets for one row from the rotation table: the same rotation as above
+    // with cos s - 1 and sin s interpolated linearly between the two nearest entries.
+    template <class V>
+    inline void radialSwirlTableRow(const RadialSwirlParams &params, int y, int x1, int x2, float *offsets)
+    {
+        typedef typename V::F F;
+        typedef typename V::I I;
+
+        const F dy = V::set1((float)(y - params.centerY));
+        const F dy2 = V::mul(dy, dy);
+        const F scale = V::set1(params.tableScale);
+        const F lastIndex = V::set1((float)(params.tableSize - 1));
+
+        alignas(64) float offsetX[V::kWidth];
+        alignas(64) float offsetY[V::kWidth];
+
+        for (int x = x1; x < x2; x += V::kWidth) {
+            const F dx = V::ramp((float)(x - params.centerX));
+            const F t = V::min(V::mul(V::sqrt(V::fmadd(dx, dx, dy2)), scale), lastIndex);
+
+            // t >= 0, so truncation is floor
+            const I i = V::truncate(t);
+            const F frac = V::sub(t, V::toFloat(i));
+            const I entry = V::shiftLeft2(i);
+            const F cosAMinus1 = V::fmadd(frac, V::gather(params.table + 2, entry), V::gather(params.table, entry));
+            const F sinA = V::fmadd(frac, V::gather(params.table + 3, entry), V::gather(params.table + 1, entry));
+
+            V::store(offsetX, V::fmsub(dx, cosAMinus1, V::mul(dy, sinA)));
+            V::store(offsetY, V::fmadd(dx, sinA, V::mul(dy, cosAMinus1)));
+
+            const int n = x2 - x < V::kWidth ? x2 - x : V::kWidth;
+            for (int k = 0; k < n; k++) {
+                offsets[2 * (x - x1 + k)] = offsetX[k];
+                offsets[2 * (x - x1 + k) + 1] = offsetY[k];
+            }
+        }
+    }
+
+}